@@ -217,6 +217,27 @@ int squareIsAttacked(Board *board, int colour, int sq) {
         || (kingAttacks(sq) & enemyKings);
 }
 
+int squareIsAttackedWith(Board *board, int colour, int sq, uint64_t occupied) {
+
+    // Legal move generation needs to know if a square would be attacked after
+    // a move, given the resulting occupancy. Enemy pieces which are no longer
+    // in the occupied bitboard, such as an enpass victim, are not attackers
+
+    uint64_t enemy = board->colours[!colour] & occupied;
+
+    uint64_t enemyPawns   = enemy &  board->pieces[PAWN  ];
+    uint64_t enemyKnights = enemy &  board->pieces[KNIGHT];
+    uint64_t enemyBishops = enemy & (board->pieces[BISHOP] | board->pieces[QUEEN]);
+    uint64_t enemyRooks   = enemy & (board->pieces[ROOK  ] | board->pieces[QUEEN]);
+    uint64_t enemyKings   = enemy &  board->pieces[KING  ];
+
+    return (pawnAttacks(colour, sq) & enemyPawns)
+        || (knightAttacks(sq) & enemyKnights)
+        || (enemyBishops && (bishopAttacks(sq, occupied) & enemyBishops))
+        || (enemyRooks && (rookAttacks(sq, occupied) & enemyRooks))
+        || (kingAttacks(sq) & enemyKings);
+}
+
 uint64_t allAttackersToSquare(Board *board, uint64_t occupied, int sq) {
 
     // When performing a static exchange evaluation we need to find all
@@ -46,6 +46,7 @@ uint64_t pawnAdvance(uint64_t pawns, uint64_t occupied, int colour);
 uint64_t pawnEnpassCaptures(uint64_t pawns, int epsq, int colour);
 
 int squareIsAttacked(Board *board, int colour, int sq);
+int squareIsAttackedWith(Board *board, int colour, int sq, uint64_t occupied);
 uint64_t attackersToSquare(Board *board, int colour, int sq);
 uint64_t allAttackedSquares(Board *board, int colour);
 uint64_t allAttackersToSquare(Board *board, uint64_t occupied, int sq);
@@ -29,7 +29,6 @@
 #include "evaluate.h"
 #include "masks.h"
 #include "move.h"
-#include "movegen.h"
 #include "search.h"
 #include "thread.h"
 #include "timeman.h"
@@ -168,11 +167,8 @@ void boardFromFEN(Board *board, const char *fen, int chess960) {
     // Move count: ignore and use zero, as we count since root
     board->numMoves = 0;
 
-    // Need king attackers for move generation
-    board->kingAttackers = attackersToKingSquare(board);
-
-    // Need squares attacked by the opposing player
-    board->threats = allAttackedSquares(board, !board->turn);
+    // King attackers and threats are computed once they are needed
+    board->validKingAttackers = board->validThreats = 0;
 
     // We save the game mode in order to comply with the UCI rules for printing
     // moves. If chess960 is not enabled, but we have detected an unconventional
@@ -280,6 +276,29 @@ void printBoard(Board *board) {
     printf("\n%s\n\n", fen);
 }
 
+uint64_t boardKingAttackers(Board *board) {
+
+    // Pieces giving check, computed upon the first request after a move
+    if (!board->validKingAttackers) {
+        board->kingAttackers = attackersToKingSquare(board);
+        board->validKingAttackers = 1;
+    }
+
+    return board->kingAttackers;
+}
+
+uint64_t boardThreats(Board *board) {
+
+    // Squares attacked by the opposing player, computed upon the first request
+    // after a move. Many nodes are cut off before their moves are ever scored
+    if (!board->validThreats) {
+        board->threats = allAttackedSquares(board, !board->turn);
+        board->validThreats = 1;
+    }
+
+    return board->threats;
+}
+
 int boardHasNonPawnMaterial(Board *board, int turn) {
     uint64_t friendly = board->colours[turn];
     uint64_t kings = board->pieces[KING];
@@ -333,26 +352,3 @@ int boardDrawnByInsufficientMaterial(Board *board) {
         && (    !several(board->pieces[KNIGHT] | board->pieces[BISHOP])
             || (!board->pieces[BISHOP] && popcount(board->pieces[KNIGHT]) <= 2));
 }
-
-uint64_t perft(Board *board, int depth) {
-
-    Undo undo[1];
-    int size = 0;
-    uint64_t found = 0ull;
-    uint16_t moves[MAX_MOVES];
-
-    if (depth == 0) return 1ull;
-
-    // Call genAllNoisyMoves() & genAllNoisyMoves()
-    size += genAllNoisyMoves(board, moves);
-    size += genAllQuietMoves(board, moves + size);
-
-    // Recurse on all valid moves
-    for(size -= 1; size >= 0; size--) {
-        applyMove(board, moves[size], undo);
-        if (moveWasLegal(board)) found += perft(board, depth-1);
-        revertMove(board, moves[size], undo);
-    }
-
-    return found;
-}
@@ -29,6 +29,7 @@ struct Board {
     uint64_t castleRooks, castleMasks[SQUARE_NB];
     int turn, epSquare, halfMoveCounter, fullMoveCounter;
     int psqtmat, numMoves, chess960;
+    int validKingAttackers, validThreats;
     uint64_t history[8192];
     Thread *thread;
 };
@@ -36,16 +37,17 @@ struct Board {
 struct Undo {
     uint64_t hash, pkhash, kingAttackers, threats, castleRooks;
     int epSquare, halfMoveCounter, psqtmat, capturePiece;
+    int validKingAttackers, validThreats;
 };
 
 void squareToString(int sq, char *str);
 void boardFromFEN(Board *board, const char *fen, int chess960);
 void boardToFEN(Board *board, char *fen);
 void printBoard(Board *board);
+uint64_t boardKingAttackers(Board *board);
+uint64_t boardThreats(Board *board);
 int boardHasNonPawnMaterial(Board *board, int turn);
 int boardIsDrawn(Board *board, int height);
 int boardDrawnByFiftyMoveRule(Board *board);
 int boardDrawnByRepetition(Board *board, int height);
 int boardDrawnByInsufficientMaterial(Board *board);
-
-uint64_t perft(Board *board, int depth);
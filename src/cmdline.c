@@ -17,14 +17,28 @@
 */
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+    #include <sys/mman.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
 #include "bitboards.h"
 #include "board.h"
 #include "cmdline.h"
+#include "mate.h"
 #include "move.h"
+#include "movegen.h"
+#include "movepicker.h"
+#include "numa.h"
+#include "perft.h"
 #include "pgn.h"
 #include "search.h"
 #include "thread.h"
@@ -35,14 +49,56 @@
 
 #include "nnue/nnue.h"
 
-static void runBenchmark(int argc, char **argv) {
+extern TTable Table;           // Defined by transposition.c
+extern int AffinityPolicy;     // Defined by windows.c
+extern int EvalCacheMB;        // Defined by thread.c
+extern int DeterministicSMP;   // Defined by thread.c
+extern int HelperSkipDepths;   // Defined by search.c
+extern int HelperWindowOffset; // Defined by search.c
+extern int HelperMoveNoise;    // Defined by search.c
+extern int MultiPVSplit;       // Defined by search.c
+extern int MateHashMB;         // Defined by mate.c
+
+static uint64_t splitmix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static const char *Benchmarks[] = {
+    #include "bench.csv"
+    ""
+};
 
-    static const char *Benchmarks[] = {
-        #include "bench.csv"
-        ""
-    };
+static double runBenchmarkPass(Thread *threads, Limits *limits, int *scores,
+    double *times, uint64_t *nodes, uint16_t *bestMoves, uint16_t *ponderMoves) {
 
     Board board;
+    double start = get_real_time();
+
+    resetThreadPool(threads);
+
+    for (int i = 0; strcmp(Benchmarks[i], ""); i++) {
+
+        // Perform the search on the position
+        limits->start = get_real_time();
+        boardFromFEN(&board, Benchmarks[i], 0);
+        getBestMove(threads, &board, limits, &bestMoves[i], &ponderMoves[i], &scores[i]);
+
+        // Stat collection for later printing
+        times[i] = get_real_time() - limits->start;
+        nodes[i] = nodesSearchedThreadPool(threads);
+
+        tt_clear(threads->nthreads); // Reset TT between searches
+        tt_near_clear(threads);
+    }
+
+    // Return the elapsed time for the entire pass
+    return get_real_time() - start;
+}
+
+static void runBenchmark(int argc, char **argv) {
+
     Thread *threads;
     Limits limits = {0};
 
@@ -52,7 +108,7 @@ static void runBenchmark(int argc, char **argv) {
     uint16_t bestMoves[256];
     uint16_t ponderMoves[256];
 
-    double time;
+    double time, baseline = 0.0;
     uint64_t totalNodes = 0ull;
 
     int depth     = argc > 2 ? atoi(argv[2]) : 13;
@@ -64,29 +120,36 @@ static void runBenchmark(int argc, char **argv) {
         printf("info string set EvalFile to %s\n", argv[5]);
     }
 
-    tt_init(nthreads, megabytes);
-    time = get_real_time();
-    threads = createThreadPool(nthreads);
-
     // Initialize a "go depth <x>" search
     limits.multiPV        = 1;
     limits.limitedByDepth = 1;
     limits.depthLimit     = depth;
 
-    for (int i = 0; strcmp(Benchmarks[i], ""); i++) {
+    // With NUMA placement of the TT, or with search threads bound to CPUs, first
+    // time a pass which leaves both to the Operating System, to report below. The
+    // Threads are created while unbound as well, so their state is not local either
+    const bool placed = Table.placement != NUMA_OFF && numa_node_count() > 1;
+    const bool bound  = AffinityPolicy != AFFINITY_OFF && nthreads > 8;
 
-        // Perform the search on the position
-        limits.start = get_real_time();
-        boardFromFEN(&board, Benchmarks[i], 0);
-        getBestMove(threads, &board, &limits, &bestMoves[i], &ponderMoves[i], &scores[i]);
+    if (placed || bound) {
 
-        // Stat collection for later printing
-        times[i] = get_real_time() - limits.start;
-        nodes[i] = nodesSearchedThreadPool(threads);
+        const int policy = AffinityPolicy;
+        Table.placement = NUMA_OFF, AffinityPolicy = AFFINITY_OFF;
+
+        threads = createThreadPool(nthreads);
+        tt_init(nthreads, megabytes);
+        time = runBenchmarkPass(threads, &limits, scores, times, nodes, bestMoves, ponderMoves);
+        deleteThreadPool(threads);
 
-        tt_clear(nthreads); // Reset TT between searches
+        for (int i = 0; strcmp(Benchmarks[i], ""); i++) totalNodes += nodes[i];
+        baseline = 1000.0f * totalNodes / (time + 1), totalNodes = 0ull;
+        Table.placement = USE_NUMA, AffinityPolicy = policy;
     }
 
+    threads = createThreadPool(nthreads);
+    tt_init(nthreads, megabytes);
+    time = runBenchmarkPass(threads, &limits, scores, times, nodes, bestMoves, ponderMoves);
+
     printf("\n===============================================================================\n");
 
     for (int i = 0; strcmp(Benchmarks[i], ""); i++) {
@@ -104,10 +167,24 @@ static void runBenchmark(int argc, char **argv) {
     printf("===============================================================================\n");
 
     // Report the overall statistics
-    time = get_real_time() - time;
     for (int i = 0; strcmp(Benchmarks[i], ""); i++) totalNodes += nodes[i];
     printf("OVERALL: %47d nodes %12d nps\n", (int)totalNodes, (int)(1000.0f * totalNodes / (time + 1)));
 
+    // Report the speedup from NUMA placement and thread binding
+    if (baseline > 0.0) {
+        double nps = 1000.0f * totalNodes / (time + 1);
+        printf("Speedup from %s%s%s: %+.2f%% (%d nps versus %d nps)\n",
+            placed ? "NUMA placement" : "", placed && bound ? " and " : "",
+            bound ? "thread affinity" : "", 100.0 * (nps - baseline) / baseline, (int) nps, (int) baseline);
+    }
+
+#ifdef USE_STATS
+    printf("===============================================================================\n");
+    tt_print_stats(threads, "");
+    printf("===============================================================================\n");
+    search_print_stats(threads, "");
+#endif
+
     deleteThreadPool(threads);
 }
 
@@ -143,14 +220,767 @@ static void runEvalBook(int argc, char **argv) {
     printf("Time %dms\n", (int)(get_real_time() - start));
 }
 
+typedef struct BookResult {
+    int score, depth, done;
+    uint16_t best;
+    uint64_t nodes;
+} BookResult;
+
+typedef struct BookQueue {
+    atomic_int next;
+    int count, depth, megabytes;
+    char **fens;
+    BookResult *results;
+} BookQueue;
+
+static void runBookSearches(BookQueue *queue) {
+
+    /// Take positions from the queue until it runs dry, searching each with a
+    /// single Thread and a private Table. The results go into the slot of the
+    /// position, so the output keeps the order of the input regardless of the
+    /// order in which the positions were claimed by each of the jobs
+
+    int score;
+    Board board;
+    Limits limits = {0};
+    uint16_t best, ponder;
+
+    // A private Table gains nothing from placing pages on NUMA nodes
+    Table.placement = NUMA_OFF;
+
+    Thread *threads = createThreadPool(1);
+    tt_init(1, queue->megabytes);
+
+    limits.multiPV = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit = queue->depth;
+
+    for (int i; (i = atomic_fetch_add(&queue->next, 1)) < queue->count; ) {
+
+        limits.start = get_real_time();
+        boardFromFEN(&board, queue->fens[i], 0);
+        getBestMove(threads, &board, &limits, &best, &ponder, &score);
+
+        queue->results[i] = (BookResult) {
+            score, threads->completed, 1, best, nodesSearchedThreadPool(threads)
+        };
+
+        resetThreadPool(threads); tt_clear(1);
+    }
+
+    deleteThreadPool(threads);
+}
+
+static void runEvalBatch(int argc, char **argv) {
+
+    /// Search every position of a FEN file with many independent jobs, each
+    /// being a single threaded search with its own small Table. Jobs are run
+    /// as separate processes, which keeps the global state of each search
+    /// apart, and they share nothing but the queue and the results. Writes
+    /// a CSV of the score, best move, depth and nodes of each position
+
+    char line[256], move[6];
+    int count = 0, capacity = 1024, launched = 0, failed = 0, missing = 0;
+    double start = get_real_time();
+
+    FILE *book    = fopen(argv[2], "r");
+    FILE *output  = fopen(argv[3], "w");
+    int depth     = argc > 4 ? atoi(argv[4]) : 12;
+    int jobs      = argc > 5 ? atoi(argv[5]) :  1;
+    int megabytes = argc > 6 ? atoi(argv[6]) :  2;
+
+    if (book == NULL || output == NULL) {
+        printf("Unable to open %s\n", book == NULL ? argv[2] : argv[3]);
+        exit(EXIT_FAILURE);
+    }
+
+    char **fens = malloc(sizeof(char*) * capacity);
+
+    while (fgets(line, 256, book) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!strlen(line)) continue;
+        if (count == capacity) fens = realloc(fens, sizeof(char*) * (capacity *= 2));
+        fens[count++] = strdup(line);
+    }
+
+    // The queue and the results must be visible to all of the jobs
+    size_t bytes = sizeof(BookQueue) + sizeof(BookResult) * MAX(1, count);
+
+#if !defined(_WIN32)
+    BookQueue *queue = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#else
+    BookQueue *queue = calloc(1, bytes);
+#endif
+
+    *queue = (BookQueue) { .count = count, .depth = depth, .megabytes = megabytes, .fens = fens };
+    queue->results = (BookResult*) (queue + 1);
+    atomic_init(&queue->next, 0);
+
+#if !defined(_WIN32)
+
+    fflush(stdout); // Don't duplicate any buffered output into the jobs
+
+    for (int i = 0; i < jobs; i++) {
+
+        pid_t pid = fork();
+
+        if (pid == 0) {
+
+            // Silence the search reports, or give up before claiming any positions
+            if (freopen("/dev/null", "w", stdout) == NULL)
+                _exit(EXIT_FAILURE);
+
+            runBookSearches(queue);
+            _exit(EXIT_SUCCESS);
+        }
+
+        launched += pid > 0;
+    }
+
+    // Jobs which crash leave their claimed positions without a result
+    for (int status; wait(&status) > 0; )
+        failed += !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+
+#else
+
+    if (jobs > 1)
+        printf("Parallel jobs are not supported on this platform, using a single job\n");
+
+#endif
+
+    // Fall back to searching here, without any jobs to do the work
+    if (!launched) runBookSearches(queue);
+
+    fprintf(output, "fen,score,bestmove,depth,nodes\n");
+
+    for (int i = 0; i < count; i++) {
+
+        // Leave out positions which were never finished, rather than writing zeroes
+        if (!queue->results[i].done) {
+            printf("No result for position %d, its job died: %s\n", i + 1, fens[i]);
+            missing++; continue;
+        }
+
+        moveToString(queue->results[i].best, move, 0);
+        fprintf(output, "%s,%d,%s,%d,%"PRIu64"\n", fens[i], queue->results[i].score,
+            move, queue->results[i].depth, queue->results[i].nodes);
+    }
+
+    double elapsed = get_real_time() - start;
+    printf("%d positions with %d jobs in %dms, %.2f positions per second\n",
+        count - missing, MAX(1, launched), (int) elapsed, 1000.0 * (count - missing) / MAX(1.0, elapsed));
+
+    if (failed || missing)
+        printf("%d of %d jobs failed, and %d positions have no result\n", failed, launched, missing);
+
+    fclose(book); fclose(output);
+
+    if (failed || missing)
+        exit(EXIT_FAILURE);
+}
+
+static void runHashBenchmark(int argc, char **argv) {
+
+    /// Compare the Transposition Table Bucket layouts using a synthetic workload. We
+    /// store more positions than the table can hold, aging the table as if we were
+    /// playing a game, and then time a mix of lookups. Half of the lookups are for
+    /// recently stored positions, which measures the hit rate, while the other half
+    /// are for positions never stored, such that any hit is a false key match
+
+    static const char *Layouts[] = { "32-byte / 3 x 16-bit", "64-byte / 5 x 32-bit" };
+
+    const uint64_t MB = 1ull << 20;
+    int megabytes   = argc > 2 ? atoi(argv[2]) : 256;
+    uint64_t probes = argc > 3 ? strtoull(argv[3], NULL, 10) : 10000000ull;
+
+    int value, eval, depth, bound;
+    uint16_t move;
+
+    Thread *thread = createThreadPool(1);
+
+    printf("\n%-22s %12s %12s %12s %14s\n", "Layout", "Entries", "ns/probe", "Hit Rate", "False Hits");
+
+    for (int layout = TT_LAYOUT_32B; layout <= TT_LAYOUT_64B; layout++) {
+
+        Table.layout = layout;
+        Table.generation = 0;
+
+        const uint64_t buckets = (uint64_t) tt_init(1, megabytes) * MB
+                               / (layout == TT_LAYOUT_64B ? sizeof(TTWideBucket) : sizeof(TTBucket));
+        const uint64_t entries = buckets * (layout == TT_LAYOUT_64B ? TT_WIDE_BUCKET_NB : TT_BUCKET_NB);
+        const uint64_t stores  = 2 * entries, window = entries / 4;
+
+        // Fill the table, starting a new "search" every 1/32nd of the stores
+        for (uint64_t i = 0; i < stores; i++) {
+            const uint64_t hash = splitmix64(i);
+            if (i % (stores / 32) == 0) tt_update();
+            tt_store(thread, hash, (uint16_t) hash, 0, 0, 1 + hash % 24, 1 + hash % 3);
+        }
+
+        uint64_t hits = 0ull, falseHits = 0ull;
+        double start = get_real_time();
+
+        // Alternate between recently stored and never stored positions
+        for (uint64_t i = 0; i < probes; i++) {
+
+            const uint64_t hash = (i & 1) ? splitmix64(stores + i)
+                                : splitmix64(stores - 1 - splitmix64(~i) % window);
+
+            if (tt_probe(thread, hash, &move, &value, &eval, &depth, &bound))
+                (i & 1) ? falseHits++ : hits++;
+        }
+
+        double elapsed = get_real_time() - start;
+
+        printf("%-22s %12"PRIu64" %12.1f %11.2f%% %10.2f ppm\n",
+            Layouts[layout], entries, 1e6 * elapsed / probes,
+            100.0 * hits / ((probes + 1) / 2), 1e6 * falseHits / (probes / 2));
+    }
+
+    printf("\n");
+    deleteThreadPool(thread);
+}
+
+static void runEvalCacheBenchmark(int argc, char **argv) {
+
+    /// Run the bench positions once per size of the static evaluation cache,
+    /// starting with the cache disabled to act as the baseline. The node counts
+    /// must not change, since the cache may only ever return identical values
+
+    static const int Sizes[] = { 0, 1, 4, 16, 64, -1 };
+
+    Limits limits = {0};
+    int scores[256];
+    double times[256];
+    uint64_t nodes[256];
+    uint16_t bestMoves[256];
+    uint16_t ponderMoves[256];
+
+    int depth     = argc > 2 ? atoi(argv[2]) : 13;
+    int megabytes = argc > 3 ? atoi(argv[3]) : 16;
+
+    double baseline = 0.0;
+    const int original = EvalCacheMB;
+
+    limits.multiPV        = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = depth;
+
+    printf("\n%-12s %14s %12s %12s %12s\n", "EvalCache", "Nodes", "Hit Rate", "NPS", "Speedup");
+
+    for (int i = 0; Sizes[i] >= 0; i++) {
+
+        EvalCacheMB = Sizes[i];
+        Thread *thread = createThreadPool(1);
+        uint64_t total = 0ull;
+
+        Table.generation = 0;
+        tt_init(1, megabytes);
+        double time = runBenchmarkPass(thread, &limits, scores, times, nodes, bestMoves, ponderMoves);
+        for (int j = 0; strcmp(Benchmarks[j], ""); j++) total += nodes[j];
+
+        double nps = 1000.0 * total / (time + 1);
+        if (i == 0) baseline = nps;
+
+        printf("%10dMB %14"PRIu64" %11.2f%% %12d %+11.2f%%\n",
+            Sizes[i], total, 100.0 * thread->evcacheHits / MAX(1, thread->evcacheProbes),
+            (int) nps, 100.0 * (nps - baseline) / baseline);
+
+        deleteThreadPool(thread);
+    }
+
+    printf("\n");
+    EvalCacheMB = original;
+}
+
+static void runNearHashBenchmark(int argc, char **argv) {
+
+    /// Run the bench positions once for each NearHashDepth, starting with the
+    /// near Tables disabled, to act as the baseline. Time to depth only counts
+    /// the searches themselves, and not the clearing of the Table between them
+
+    Limits limits = {0};
+    int scores[256];
+    double times[256];
+    uint64_t nodes[256];
+    uint16_t bestMoves[256];
+    uint16_t ponderMoves[256];
+
+    int depth     = argc > 2 ? atoi(argv[2]) : 13;
+    int megabytes = argc > 3 ? atoi(argv[3]) : 1024;
+    int maxDepth  = argc > 4 ? atoi(argv[4]) :  3;
+
+    double baseline = 0.0;
+    const int original = Table.nearDepth;
+
+    limits.multiPV        = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = depth;
+
+    printf("\n%-14s %14s %12s %12s %12s %12s\n",
+        "NearHashDepth", "Nodes", "Near Hits", "NPS", "Time", "Speedup");
+
+    for (int near = 0; near <= MIN(maxDepth, TT_NEAR_MAX_DEPTH); near++) {
+
+        Table.nearDepth = near;
+        Thread *thread = createThreadPool(1);
+        uint64_t total = 0ull;
+        double elapsed = 0.0;
+
+        Table.generation = 0;
+        tt_init(1, megabytes);
+        runBenchmarkPass(thread, &limits, scores, times, nodes, bestMoves, ponderMoves);
+
+        for (int j = 0; strcmp(Benchmarks[j], ""); j++)
+            total += nodes[j], elapsed += times[j];
+
+        if (near == 0) baseline = elapsed;
+
+        printf("%14d %14"PRIu64" %12"PRIu64" %12d %10dms %+11.2f%%\n",
+            near, total, thread->ttstats.nearHits, (int) (1000.0 * total / (elapsed + 1)),
+            (int) elapsed, 100.0 * (baseline - elapsed) / elapsed);
+
+        deleteThreadPool(thread);
+    }
+
+    printf("\n");
+    Table.nearDepth = original;
+}
+
+static void runScaleBenchmark(int argc, char **argv) {
+
+    /// Run the bench positions with 1, 2, 4 ... N threads. Each run is compared
+    /// to the single threaded run, both by the nodes searched per second, and by
+    /// the time taken to reach the bench depth. The agreement is the share of the
+    /// positions where the best move matches the one found by the single thread.
+    /// With diversify set, the Helper options are enabled with typical values
+
+    Limits limits = {0};
+    int scores[256];
+    double times[256];
+    uint64_t nodes[256];
+    uint16_t bestMoves[256], baseMoves[256];
+    uint16_t ponderMoves[256];
+
+    int depth      = argc > 2 ? atoi(argv[2]) : 13;
+    int maxThreads = argc > 3 ? atoi(argv[3]) :  8;
+    int megabytes  = argc > 4 ? atoi(argv[4]) : 64;
+    int diversify  = argc > 5 ? atoi(argv[5]) :  0;
+
+    double baseNPS = 0.0, baseTime = 0.0;
+
+    if (diversify)
+        HelperSkipDepths = 1, HelperWindowOffset = 5, HelperMoveNoise = 256;
+
+    limits.multiPV        = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = depth;
+
+    printf("\n%-8s %14s %12s %12s %12s %12s %12s\n",
+        "Threads", "Nodes", "NPS", "Speedup", "Time", "Speedup", "Agreement");
+
+    for (int nthreads = 1; nthreads <= maxThreads; nthreads *= 2) {
+
+        Thread *threads = createThreadPool(nthreads);
+        uint64_t total = 0ull;
+        double elapsed = 0.0;
+        int positions = 0, agreed = 0;
+
+        Table.generation = 0;
+        tt_init(nthreads, megabytes);
+        runBenchmarkPass(threads, &limits, scores, times, nodes, bestMoves, ponderMoves);
+
+        for (int i = 0; strcmp(Benchmarks[i], ""); i++, positions++) {
+            total += nodes[i], elapsed += times[i];
+            if (nthreads == 1) baseMoves[i] = bestMoves[i];
+            agreed += bestMoves[i] == baseMoves[i];
+        }
+
+        const double nps = 1000.0 * total / (elapsed + 1);
+        if (nthreads == 1) baseNPS = nps, baseTime = elapsed;
+
+        printf("%-8d %14"PRIu64" %12d %11.2fx %10dms %11.2fx %11.2f%%\n",
+            nthreads, total, (int) nps, nps / baseNPS, (int) elapsed,
+            baseTime / MAX(1.0, elapsed), 100.0 * agreed / positions);
+
+        deleteThreadPool(threads);
+    }
+
+    printf("\n");
+}
+
+static void runMultiPVBenchmark(int argc, char **argv) {
+
+    /// Run the bench positions as MultiPV searches, first with every thread
+    /// searching every line, and then with the root moves split between the
+    /// threads. Time to depth only counts the searches themselves. Agreement
+    /// is the share of positions where both modes found the same best move
+
+    static const char *Modes[] = { "Every line", "Split moves" };
+
+    Limits limits = {0};
+    int scores[256];
+    double times[256];
+    uint64_t nodes[256];
+    uint16_t bestMoves[2][256];
+    uint16_t ponderMoves[256];
+
+    int depth     = argc > 2 ? atoi(argv[2]) : 10;
+    int multiPV   = argc > 3 ? atoi(argv[3]) :  8;
+    int nthreads  = argc > 4 ? atoi(argv[4]) :  4;
+    int megabytes = argc > 5 ? atoi(argv[5]) : 64;
+
+    double elapsed[2] = {0};
+    uint64_t total[2] = {0};
+    int positions = 0, agreed = 0;
+    const int original = MultiPVSplit;
+
+    limits.multiPV        = multiPV;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = depth;
+
+    for (int mode = 0; mode < 2; mode++) {
+
+        Thread *threads = createThreadPool(nthreads);
+
+        MultiPVSplit = mode;
+        Table.generation = 0;
+        tt_init(nthreads, megabytes);
+        runBenchmarkPass(threads, &limits, scores, times, nodes, bestMoves[mode], ponderMoves);
+
+        for (int i = 0; strcmp(Benchmarks[i], ""); i++)
+            total[mode] += nodes[i], elapsed[mode] += times[i];
+
+        deleteThreadPool(threads);
+    }
+
+    for (int i = 0; strcmp(Benchmarks[i], ""); i++, positions++)
+        agreed += bestMoves[0][i] == bestMoves[1][i];
+
+    printf("\n%d threads, MultiPV %d, depth %d\n", nthreads, multiPV, depth);
+    printf("%-12s %14s %12s %12s\n", "Mode", "Nodes", "Time", "Speedup");
+
+    for (int mode = 0; mode < 2; mode++)
+        printf("%-12s %14"PRIu64" %10dms %11.2fx\n", Modes[mode], total[mode],
+            (int) elapsed[mode], elapsed[0] / MAX(1.0, elapsed[mode]));
+
+    printf("Best moves agree in %.2f%% of positions\n\n", 100.0 * agreed / positions);
+    MultiPVSplit = original;
+}
+
+static void runMateBenchmark(int argc, char **argv) {
+
+    /// Solve a set of mate puzzles, given as "<fen> ;DM <n>", with both the
+    /// proof-number search used for "go mate" and with the regular search,
+    /// which stops once it reports a mate at least as short as the puzzle's.
+    /// A puzzle is solved when the expected mate length is found in time
+
+    static const char *Modes[] = { "Proof-number", "Alpha-beta" };
+
+    int score;
+    Board board;
+    char line[256];
+    Limits limits = {0};
+    uint16_t best, ponder;
+
+    FILE *book    = fopen(argc > 2 ? argv[2] : "mates.epd", "r");
+    int timeLimit = argc > 3 ? atoi(argv[3]) : 10000;
+    int megabytes = argc > 4 ? atoi(argv[4]) :    16;
+
+    double elapsed[2] = {0};
+    uint64_t total[2] = {0};
+    int solved[2] = {0}, positions = 0;
+
+    if (book == NULL) {
+        printf("Unable to open %s\n", argc > 2 ? argv[2] : "mates.epd");
+        return;
+    }
+
+    Thread *threads = createThreadPool(1);
+
+    limits.multiPV        = 1;
+    limits.limitedByTime  = 1;
+    limits.timeLimit      = timeLimit;
+    limits.limitedByMate  = 1;
+    MateHashMB            = megabytes;
+    tt_init(1, megabytes);
+
+    while (fgets(line, 256, book) != NULL) {
+
+        bool found[2];
+        double times[2];
+        uint64_t nodes[2];
+
+        char *dm = strstr(line, ";DM");
+        if (dm == NULL) continue;
+
+        limits.mateLimit = atoi(dm + 3);
+
+        for (int mode = 0; mode < 2; mode++) {
+
+            Table.generation = 0;
+            tt_clear(1); resetThreadPool(threads);
+
+            limits.start = get_real_time();
+            boardFromFEN(&board, line, 0);
+
+            if (mode == 0) mateSearch(threads, &board, &limits, &best, &ponder, &score);
+            else          getBestMove(threads, &board, &limits, &best, &ponder, &score);
+
+            times[mode] = get_real_time() - limits.start;
+            nodes[mode] = threads->nodes;
+            found[mode] = score >= MATE - 2 * limits.mateLimit + 1;
+
+            solved[mode] += found[mode], total[mode] += nodes[mode], elapsed[mode] += times[mode];
+        }
+
+        printf("Mate in %d: %s %"PRIu64" nodes %dms, %s %"PRIu64" nodes %dms\n", limits.mateLimit,
+            found[0] ? "solved" : "missed", nodes[0], (int) times[0],
+            found[1] ? "solved" : "missed", nodes[1], (int) times[1]);
+
+        positions++;
+    }
+
+    printf("\n%d positions, %dms per position\n", positions, timeLimit);
+    printf("%-14s %8s %14s %12s\n", "Search", "Solved", "Nodes", "Time");
+
+    for (int mode = 0; mode < 2; mode++)
+        printf("%-14s %5d/%-3d %14"PRIu64" %10dms\n", Modes[mode],
+            solved[mode], positions, total[mode], (int) elapsed[mode]);
+
+    printf("\n");
+    fclose(book);
+    deleteThreadPool(threads);
+}
+
+static int runPerftSuite(int argc, char **argv) {
+
+    /// Verify every "<fen> ;D1 <n> ;D2 <n> ..." entry of a perft file up to the
+    /// given depth, printing each failure, and report the overall speed. The
+    /// return value is the number of failures, so that scripts may gate on it
+
+    Board board;
+    char line[1024];
+    uint16_t moves[MAX_MOVES];
+    uint64_t counts[MAX_MOVES], nodes = 0;
+    int size, entries = 0, failures = 0;
+
+    char *fname   = argc > 2 ? argv[2] : "perft/fischer.epd";
+    int maxDepth  = argc > 3 ? atoi(argv[3]) : 4;
+    int nthreads  = argc > 4 ? atoi(argv[4]) : 1;
+    int megabytes = argc > 5 ? atoi(argv[5]) : 0;
+
+    FILE *fin = fopen(fname, "r");
+    double elapsed = 0.0;
+
+    if (fin == NULL) {
+        printf("Unable to open %s\n", fname);
+        return 1;
+    }
+
+    while (fgets(line, 1024, fin) != NULL) {
+
+        boardFromFEN(&board, line, 0);
+
+        for (char *token = strchr(line, ';'); token != NULL; token = strchr(token + 1, ';')) {
+
+            int depth; uint64_t expected;
+            if (sscanf(token, ";D%d %"SCNu64, &depth, &expected) != 2 || depth > maxDepth)
+                continue;
+
+            double start = get_real_time();
+            uint64_t found = perftRoot(&board, depth, nthreads, megabytes, moves, counts, &size);
+            elapsed += get_real_time() - start;
+
+            nodes += found, entries += 1;
+
+            if (found != expected) {
+                failures += 1;
+                printf("FAIL D%d expected %"PRIu64" found %"PRIu64" %s",
+                    depth, expected, found, line);
+            }
+        }
+    }
+
+    fclose(fin);
+
+    printf("\n%d of %d entries passed to depth %d, %d threads, %dMB hash\n",
+        entries - failures, entries, maxDepth, nthreads, megabytes);
+    printf("Nodes %"PRIu64" Time %dms MNPS %.2f\n\n",
+        nodes, (int) elapsed, nodes / (1000.0 * MAX(1.0, elapsed)));
+
+    return failures;
+}
+
+static void runPickerBenchmark(int argc, char **argv) {
+
+    /// Time the Move Picker on positions found by short random walks from the
+    /// bench positions, after a search of each has filled in the histories. For
+    /// every node the picker is run to completion many times, both as in the
+    /// main search, and as in qsearch where only noisy moves are considered
+
+    static const char *Pickers[] = { "Main", "Noisy" };
+
+    Board board;
+    MovePicker mp;
+    Limits limits = {0};
+    uint16_t best, ponder, moves[MAX_MOVES], line[8];
+    int score;
+
+    int depth      = argc > 2 ? atoi(argv[2]) :  10;
+    int walks      = argc > 3 ? atoi(argv[3]) :  64;
+    int iterations = argc > 4 ? atoi(argv[4]) : 200;
+
+    double elapsed[2] = {0};
+    uint64_t nodes[2] = {0}, picked[2] = {0};
+
+    Thread *threads = createThreadPool(1);
+    Thread *const thread = &threads[0];
+
+    limits.multiPV        = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = depth;
+    tt_init(1, 16);
+
+    for (int i = 0; strcmp(Benchmarks[i], ""); i++) {
+
+        limits.start = get_real_time();
+        boardFromFEN(&board, Benchmarks[i], 0);
+        getBestMove(threads, &board, &limits, &best, &ponder, &score);
+
+        for (int type = 0; type < 2; type++) {
+
+            double start = get_real_time();
+
+            for (int walk = 0; walk < walks; walk++) {
+
+                uint64_t seed = splitmix64(((uint64_t) i << 32) | walk);
+                int length = 0, plies = 1 + seed % 8;
+
+                // Walk the same random legal moves for both types of picker
+                for (; length < plies; length++) {
+                    int size = genAllLegalMoves(&thread->board, moves);
+                    if (!size) break;
+                    seed = splitmix64(seed);
+                    applyLegal(thread, &thread->board, line[length] = moves[seed % size]);
+                }
+
+                for (int iter = 0; iter < iterations; iter++) {
+
+                    if (type == 0) init_picker(&mp, thread, NONE_MOVE);
+                    else init_noisy_picker(&mp, thread, NONE_MOVE, 0);
+
+                    while (select_next(&mp, thread, type) != NONE_MOVE)
+                        picked[type]++;
+                }
+
+                while (length) revert(thread, &thread->board, line[--length]);
+                nodes[type] += iterations;
+            }
+
+            elapsed[type] += get_real_time() - start;
+        }
+
+        tt_clear(1);
+    }
+
+    printf("\n%d walks and %d iterations per position, after depth %d\n", walks, iterations, depth);
+    printf("%-8s %12s %12s %12s %12s\n", "Picker", "Nodes", "Moves", "ns/Node", "ns/Move");
+
+    for (int type = 0; type < 2; type++)
+        printf("%-8s %12"PRIu64" %12"PRIu64" %12.1f %12.1f\n", Pickers[type], nodes[type], picked[type],
+            1e6 * elapsed[type] / nodes[type], 1e6 * elapsed[type] / MAX(1, picked[type]));
+
+    printf("\n");
+    deleteThreadPool(threads);
+}
+
+static void *runNothing(void *cargo) { return cargo; }
+
+static void runWakeBenchmark(int argc, char **argv) {
+
+    /// Measure the cost of handing work to the helper threads. First, a job which
+    /// does nothing is given to each parked Worker, and compared to creating and
+    /// joining a pthread for it, as was done for every search. Second, a stream of
+    /// very short searches is timed, as seen in bullet games and rapid analysis
+
+    Board board;
+    Limits limits = {0};
+    uint16_t best, ponder;
+    int score;
+
+    int nthreads   = argc > 2 ? atoi(argv[2]) :    4;
+    int iterations = argc > 3 ? atoi(argv[3]) : 2000;
+
+    Thread *threads = createThreadPool(nthreads);
+    pthread_t pthreads[nthreads];
+
+    double start = get_real_time();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 1; j < nthreads; j++) startWorker(&threads[j].worker, runNothing, NULL);
+        for (int j = 1; j < nthreads; j++) waitWorker(&threads[j].worker);
+    }
+    double parked = get_real_time() - start;
+
+    start = get_real_time();
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 1; j < nthreads; j++) pthread_create(&pthreads[j], NULL, runNothing, NULL);
+        for (int j = 1; j < nthreads; j++) pthread_join(pthreads[j], NULL);
+    }
+    double created = get_real_time() - start;
+
+    // Initialize a "go depth 1" search from the starting position
+    limits.multiPV        = 1;
+    limits.limitedByDepth = 1;
+    limits.depthLimit     = 1;
+    tt_init(nthreads, 16);
+
+    start = get_real_time();
+    for (int i = 0; i < iterations; i++) {
+        limits.start = get_real_time();
+        boardFromFEN(&board, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0);
+        getBestMove(threads, &board, &limits, &best, &ponder, &score);
+    }
+    double searching = get_real_time() - start;
+
+    printf("\n%d threads, %d iterations\n", nthreads, iterations);
+    printf("Wake parked Workers  %10.2f us\n", 1000.0 * parked / iterations);
+    printf("Create and join      %10.2f us\n", 1000.0 * created / iterations);
+    printf("Search to depth 1    %10.2f us\n\n", 1000.0 * searching / iterations);
+
+    deleteThreadPool(threads);
+}
+
 void handleCommandLine(int argc, char **argv) {
 
     // Output all the wonderful things we can do from the Command Line
     if (argc > 1 && strEquals(argv[1], "--help")) {
         printf("\nbench     [depth=13] [threads=1] [hash=16] [NNUE=None]");
         printf("\n          Run searches on a set of positions to compute a hash\n");
+        printf("\ndetbench  [depth=13] [threads=1] [hash=16] [NNUE=None]");
+        printf("\n          Run bench with a reproducible multithreaded search\n");
         printf("\nevalbook  [input-file] [depth=12] [threads=1] [hash=2]");
         printf("\n          Evaluate all positions in a FEN file using various options\n");
+        printf("\nevalbatch [input-file] [output-file] [depth=12] [jobs=1] [hash=2]");
+        printf("\n          Search all positions in a FEN file with parallel jobs, writing a CSV\n");
+        printf("\nttbench   [hash=256] [probes=10000000]");
+        printf("\n          Compare probe latency and hit rates of the TT layouts\n");
+        printf("\nevalbench [depth=13] [hash=16]");
+        printf("\n          Compare hit rates and speed of static evaluation cache sizes\n");
+        printf("\nnearbench [depth=13] [hash=1024] [max-depth=3]");
+        printf("\n          Compare speed and time to depth of each NearHashDepth\n");
+        printf("\nscalebench [depth=13] [max-threads=8] [hash=64] [diversify=0]");
+        printf("\n          Compare speed, time to depth and best moves over thread counts\n");
+        printf("\nmultipvbench [depth=10] [multipv=8] [threads=4] [hash=64]");
+        printf("\n          Compare time to depth of MultiPV searches with and without splitting\n");
+        printf("\nmatebench [epd-file=mates.epd] [time=10000] [hash=16]");
+        printf("\n          Compare the proof-number and regular searches on mate puzzles\n");
+        printf("\nperftsuite [epd-file=perft/fischer.epd] [depth=4] [threads=1] [hash=0]");
+        printf("\n          Verify and time every perft entry of a file, failing on any mismatch\n");
+        printf("\npickerbench [depth=10] [walks=64] [iterations=200]");
+        printf("\n          Measure the cost of the Move Picker per node on the bench positions\n");
+        printf("\nwakebench [threads=4] [iterations=2000]");
+        printf("\n          Measure the latency of waking the helper threads for a search\n");
         printf("\nnndata    [input-file] [output-file]");
         printf("\n          Build an nndata from a stripped pgn file\n");
         exit(EXIT_SUCCESS);
@@ -162,12 +992,77 @@ void handleCommandLine(int argc, char **argv) {
         exit(EXIT_SUCCESS);
     }
 
+    // Benchmark with helpers which synchronise after every depth
+    if (argc > 1 && strEquals(argv[1], "detbench")) {
+        DeterministicSMP = 1;
+        runBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
     // Evaluate all positions in a datafile to a given depth
     if (argc > 2 && strEquals(argv[1], "evalbook")) {
         runEvalBook(argc, argv);
         exit(EXIT_SUCCESS);
     }
 
+    // Search all positions in a datafile, with a job per core
+    if (argc > 3 && strEquals(argv[1], "evalbatch")) {
+        runEvalBatch(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Compare the Transposition Table Bucket layouts
+    if (argc > 1 && strEquals(argv[1], "ttbench")) {
+        runHashBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Compare sizes of the static evaluation cache
+    if (argc > 1 && strEquals(argv[1], "evalbench")) {
+        runEvalCacheBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Compare depths for the per-thread near Transposition Tables
+    if (argc > 1 && strEquals(argv[1], "nearbench")) {
+        runNearHashBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Measure the scaling of the search over thread counts
+    if (argc > 1 && strEquals(argv[1], "scalebench")) {
+        runScaleBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Compare MultiPV searches with and without splitting the root moves
+    if (argc > 1 && strEquals(argv[1], "multipvbench")) {
+        runMultiPVBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Compare the searches for "go mate" on a set of mate puzzles
+    if (argc > 1 && strEquals(argv[1], "matebench")) {
+        runMateBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Verify move generation against a perft file, for use as a gate
+    if (argc > 1 && strEquals(argv[1], "perftsuite"))
+        exit(runPerftSuite(argc, argv) ? EXIT_FAILURE : EXIT_SUCCESS);
+
+    // Measure the cost of ordering and selecting moves
+    if (argc > 1 && strEquals(argv[1], "pickerbench")) {
+        runPickerBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Measure the latency of starting a search on the helpers
+    if (argc > 1 && strEquals(argv[1], "wakebench")) {
+        runWakeBenchmark(argc, argv);
+        exit(EXIT_SUCCESS);
+    }
+
     // Convert a PGN file to an nndata file
     if (argc > 3 && strEquals(argv[1], "nndata")) {
         process_pgn(argv[2], argv[3]);
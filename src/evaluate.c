@@ -440,11 +440,22 @@ const int Tempo = 20;
 int evaluateBoard(Thread *thread, Board *board) {
 
     int phase, eval, pkeval, factor = SCALE_NORMAL;
+    uint64_t *cached = NULL;
 
     // We can recognize positions we just evaluated
     if (thread->states[thread->height-1].move == NULL_MOVE)
         return -thread->states[thread->height-1].eval + 2 * Tempo;
 
+    // Each cache entry packs the upper 48 bits of the Hash with the evaluation
+    if (!TRACE && thread->evcache != NULL) {
+
+        cached = &thread->evcache[board->hash & thread->evcacheMask];
+        thread->evcacheProbes++;
+
+        if ((*cached ^ board->hash) >> 16 == 0)
+            return thread->evcacheHits++, (int16_t) (*cached & 0xFFFF);
+    }
+
     // Use the NNUE unless we are in an extremely unbalanced position
     if (USE_NNUE && abs(ScoreEG(board->psqtmat)) <= 2000) {
         eval = nnue_evaluate(thread, board);
@@ -484,7 +495,12 @@ int evaluateBoard(Thread *thread, Board *board) {
 
     // Factor in the Tempo after interpolation and scaling, so that
     // if a null move is made, then we know eval = last_eval + 2 * Tempo
-    return Tempo + (board->turn == WHITE ? eval : -eval);
+    eval = Tempo + (board->turn == WHITE ? eval : -eval);
+
+    if (cached != NULL)
+        *cached = (board->hash & ~0xFFFFull) | (uint16_t) eval;
+
+    return eval;
 }
 
 int evaluatePieces(EvalInfo *ei, Board *board) {
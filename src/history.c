@@ -20,6 +20,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#if defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
+
 #include "bitboards.h"
 #include "board.h"
 #include "history.h"
@@ -48,14 +52,38 @@ static int history_captured_piece(Thread *thread, uint16_t move) {
          : pieceType(thread->board.squares[MoveTo(move)]);
 }
 
+static void gather_histories(const int16_t *table, const int32_t *indices, int *scores, int length) {
+
+    /// Add table[indices[i]] to scores[i] for every i. AVX2 gathers eight
+    /// histories at once, reading 32 bits at each 16-bit Entry and keeping the
+    /// sign extended lower half. The extra two bytes past the final Entry of a
+    /// table are still within the Thread, or within the padding of NullHistory
+
+    int i = 0;
+
+#if defined(USE_AVX2)
+    for (; i + 8 <= length; i += 8) {
+        const __m256i index = _mm256_loadu_si256((const __m256i*) &indices[i]);
+        const __m256i raw   = _mm256_i32gather_epi32((const int*) table, index, 2);
+        const __m256i hist  = _mm256_srai_epi32(_mm256_slli_epi32(raw, 16), 16);
+        const __m256i sum   = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) &scores[i]), hist);
+        _mm256_storeu_si256((__m256i*) &scores[i], sum);
+    }
+#endif
+
+    for (; i < length; i++)
+        scores[i] += table[indices[i]];
+}
+
 static int16_t* underlying_capture_history(Thread *thread, uint16_t move) {
 
-    const int captured = history_captured_piece(thread, move);
-    const int piece    = pieceType(thread->board.squares[MoveFrom(move)]);
+    const int captured     = history_captured_piece(thread, move);
+    const int piece        = pieceType(thread->board.squares[MoveFrom(move)]);
+    const uint64_t threats = boardThreats(&thread->board);
 
     // Determine if piece evades and/or enters a threat
-    const bool threat_from = testBit(thread->board.threats, MoveFrom(move));
-    const bool threat_to   = testBit(thread->board.threats, MoveTo(move));
+    const bool threat_from = testBit(threats, MoveFrom(move));
+    const bool threat_to   = testBit(threats, MoveTo(move));
 
     assert(PAWN <= captured && captured <= QUEEN);
     assert(PAWN <= piece && piece <= KING);
@@ -68,7 +96,7 @@ static void underlying_quiet_history(Thread *thread, uint16_t move, int16_t *his
     static int16_t NULL_HISTORY; // Always zero to handle missing CM/FM history
 
     NodeState *const ns    = &thread->states[thread->height];
-    const uint64_t threats = thread->board.threats;
+    const uint64_t threats = boardThreats(&thread->board);
 
     // Extract information from this move
     const int to    = MoveTo(move);
@@ -145,9 +173,25 @@ void get_capture_histories(Thread *thread, uint16_t *moves, int *scores, int sta
 
     static const int MVVAugment[] = { 0, 2400, 2400, 4800, 9600 };
 
-    for (int i = start; i < start + length; i++)
-        scores[i] = 64000 + get_capture_history(thread, moves[i])
-                  + MVVAugment[history_captured_piece(thread, moves[i])];
+    const uint64_t threats = boardThreats(&thread->board);
+    int32_t indices[MAX_MOVES];
+
+    // Compute every offset into the Capture History, and the fixed bonuses,
+    // before gathering all of the histories at once
+    for (int i = 0; i < length; i++) {
+
+        const uint16_t move = moves[start + i];
+        const int captured  = history_captured_piece(thread, move);
+        const int piece     = pieceType(thread->board.squares[MoveFrom(move)]);
+
+        const int threat_from = testBit(threats, MoveFrom(move));
+        const int threat_to   = testBit(threats, MoveTo(move));
+
+        indices[i] = (((piece * 2 + threat_from) * 2 + threat_to) * SQUARE_NB + MoveTo(move)) * (PIECE_NB - 1) + captured;
+        scores[start + i] = 64000 + 64000 * (MovePromoPiece(move) == QUEEN) + MVVAugment[captured];
+    }
+
+    gather_histories(&thread->chistory[0][0][0][0][0], indices, scores + start, length);
 }
 
 void update_capture_histories(Thread *thread, uint16_t best, uint16_t *moves, int length, int depth) {
@@ -173,10 +217,39 @@ int get_quiet_history(Thread *thread, uint16_t move, int *cmhist, int *fmhist) {
 
 void get_quiet_histories(Thread *thread, uint16_t *moves, int *scores, int start, int length) {
 
-    int null_hist; // cmhist & fmhist are set, although ignored
+    // Always zero to handle missing CM/FM history, padded for the AVX2 gathers
+    static const int16_t NullHistory[PIECE_NB * SQUARE_NB + 2];
+
+    NodeState *const ns    = &thread->states[thread->height];
+    const uint64_t threats = boardThreats(&thread->board);
+
+    const int16_t *cmhist = (ns-1)->continuations == NULL
+                          ? NullHistory : &(*(ns-1)->continuations)[0][0][0];
+
+    const int16_t *fmhist = (ns-2)->continuations == NULL
+                          ? NullHistory : &(*(ns-2)->continuations)[1][0][0];
+
+    int32_t pieceTo[MAX_MOVES], fromTo[MAX_MOVES];
+
+    // Compute every offset into the Continuation and Butterfly Histories,
+    // before gathering each of the three histories for all moves at once
+    for (int i = 0; i < length; i++) {
+
+        const int to    = MoveTo(moves[start + i]);
+        const int from  = MoveFrom(moves[start + i]);
+        const int piece = pieceType(thread->board.squares[from]);
+
+        const int threat_from = testBit(threats, from);
+        const int threat_to   = testBit(threats, to);
+
+        pieceTo[i] = piece * SQUARE_NB + to;
+        fromTo[i]  = ((threat_from * 2 + threat_to) * SQUARE_NB + from) * SQUARE_NB + to;
+        scores[start + i] = 0;
+    }
 
-    for (int i = start; i < start + length; i++)
-        scores[i] = get_quiet_history(thread, moves[i], &null_hist, &null_hist);
+    gather_histories(cmhist, pieceTo, scores + start, length);
+    gather_histories(fmhist, pieceTo, scores + start, length);
+    gather_histories(&thread->history[thread->board.turn][0][0][0][0], fromTo, scores + start, length);
 }
 
 void update_quiet_histories(Thread *thread, uint16_t *moves, int length, int depth) {
@@ -0,0 +1,312 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "mate.h"
+#include "move.h"
+#include "movegen.h"
+#include "search.h"
+#include "thread.h"
+#include "timeman.h"
+#include "types.h"
+#include "uci.h"
+
+int MateHashMB = 16; // Size of the proof number table, set by UCI option MateHash
+
+static MateEntry *MateTable; // Two Entries per Bucket, allocated by the first search
+static uint64_t MateMask;    // Mask of the Bucket index, for the current MateTable
+static int MateTableMB;      // Megabytes of the current MateTable, to detect resizes
+static bool MateStopped;     // Set once the search runs out of time or nodes
+static uint64_t MatePolls;   // Calls to mate_limits_reached(), to poll sparingly
+
+extern atomic_int ABORT_SIGNAL; // Defined by search.c
+
+static uint64_t mate_key(uint64_t hash, int left) {
+
+    // Proofs only hold for the number of plies that they were found with
+    return hash ^ (0x9E3779B97F4A7C15ull * (uint64_t) (left + 1));
+}
+
+static uint32_t mate_add(uint32_t a, uint32_t b) {
+    return MIN(MATE_INFINITY, a + b);
+}
+
+static void mate_table_init() {
+
+    // Allocate the table on first use or after a resize, and clear it
+    if (MateTable == NULL || MateTableMB != MateHashMB) {
+
+        uint64_t buckets = 1;
+        while (4 * buckets * sizeof(MateEntry) <= (uint64_t) MateHashMB << 20)
+            buckets *= 2;
+
+        free(MateTable);
+        MateTable   = malloc(2 * buckets * sizeof(MateEntry));
+        MateMask    = buckets - 1;
+        MateTableMB = MateHashMB;
+    }
+
+    memset(MateTable, 0, 2 * (MateMask + 1) * sizeof(MateEntry));
+}
+
+static bool mate_probe(uint64_t key, uint32_t *pn, uint32_t *dn) {
+
+    MateEntry *bucket = &MateTable[2 * (key & MateMask)];
+
+    for (int i = 0; i < 2; i++)
+        if (bucket[i].key == key && (bucket[i].pn || bucket[i].dn))
+            return *pn = bucket[i].pn, *dn = bucket[i].dn, true;
+
+    return *pn = 1, *dn = 1, false;
+}
+
+static void mate_store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work) {
+
+    // Replace a matching Entry, or otherwise the one which took less work
+    MateEntry *bucket  = &MateTable[2 * (key & MateMask)];
+    MateEntry *replace = bucket[1].key == key || bucket[1].work < bucket[0].work ? &bucket[1] : &bucket[0];
+
+    if (bucket[0].key == key) replace = &bucket[0];
+
+    *replace = (MateEntry) { key, pn, dn, work };
+}
+
+static bool mate_limits_reached(Thread *thread) {
+
+    // Poll the stopping conditions once every 1024 calls
+    if (++MatePolls & 1023)
+        return MateStopped;
+
+    const Limits *limits = thread->limits;
+
+    return MateStopped = ABORT_SIGNAL
+        || (limits->limitedByTime  && elapsed_time(thread->tm) >= limits->timeLimit)
+        || (limits->limitedByNodes && thread->nodes >= limits->nodeLimit);
+}
+
+static int mate_moves(Thread *thread, int left, bool attacker, uint16_t *moves) {
+
+    // The final move of the attacker is only useful if it gives check
+
+    Board *const board = &thread->board;
+    int size = genAllLegalMoves(board, moves), count = 0;
+
+    if (!attacker || left != 1)
+        return size;
+
+    for (int i = 0; i < size; i++) {
+        applyLegal(thread, board, moves[i]);
+        if (boardKingAttackers(board)) moves[count++] = moves[i];
+        revert(thread, board, moves[i]);
+    }
+
+    return count;
+}
+
+static void mate_dfpn(Thread *thread, int left, bool attacker, uint32_t thpn, uint32_t thdn, uint32_t *pn, uint32_t *dn) {
+
+    /// Expand the position until either its proof number reaches thpn or its
+    /// disproof number reaches thdn. The attacker chooses a single move, so a
+    /// proof requires any one child and a disproof requires all of them. The
+    /// defender is the reverse. The most proving child is searched with the
+    /// thresholds that keep it the most proving among its siblings
+
+    Board *const board = &thread->board;
+    const uint64_t key = mate_key(board->hash, left), start = thread->nodes++;
+
+    uint16_t moves[MAX_MOVES];
+    uint32_t pns[MAX_MOVES], dns[MAX_MOVES];
+
+    int size = mate_moves(thread, left, attacker, moves);
+
+    // Side to move is mated, which proves a mate when the defender is to move
+    if (!size && boardKingAttackers(board) && !attacker) {
+        *pn = 0, *dn = MATE_INFINITY;
+        mate_store(key, *pn, *dn, 1);
+        return;
+    }
+
+    // Stalemates, running out of plies, and any other leaf fails to mate
+    if (!size || !left) {
+        *pn = MATE_INFINITY, *dn = 0;
+        mate_store(key, *pn, *dn, 1);
+        return;
+    }
+
+    // Children start with the numbers of any previous searches
+    for (int i = 0; i < size; i++) {
+        applyLegal(thread, board, moves[i]);
+        mate_probe(mate_key(board->hash, left - 1), &pns[i], &dns[i]);
+        revert(thread, board, moves[i]);
+    }
+
+    while (true) {
+
+        int bestIdx = 0;
+        uint32_t second = MATE_INFINITY;
+
+        // Attacker picks by the proof number, the defender by the disproof number
+        uint32_t *select = attacker ? pns : dns, *other = attacker ? dns : pns;
+        uint32_t minimum = select[0], total = other[0];
+
+        for (int i = 1; i < size; i++) {
+
+            total = mate_add(total, other[i]);
+
+            if (select[i] < minimum)
+                second = minimum, minimum = select[i], bestIdx = i;
+            else if (select[i] < second)
+                second = select[i];
+        }
+
+        *pn = attacker ? minimum : total;
+        *dn = attacker ? total : minimum;
+
+        if (*pn >= thpn || *dn >= thdn || mate_limits_reached(thread))
+            break;
+
+        // Thresholds which end the child search once a sibling takes over
+        uint32_t cthpn = attacker ? MIN(thpn, second + 1) : thpn - *pn + pns[bestIdx];
+        uint32_t cthdn = attacker ? thdn - *dn + dns[bestIdx] : MIN(thdn, second + 1);
+
+        applyLegal(thread, board, moves[bestIdx]);
+        mate_dfpn(thread, left - 1, !attacker, cthpn, cthdn, &pns[bestIdx], &dns[bestIdx]);
+        revert(thread, board, moves[bestIdx]);
+    }
+
+    mate_store(key, *pn, *dn, thread->nodes - start);
+}
+
+static void mate_principal_variation(Thread *thread, int left, PVariation *pv) {
+
+    /// Follow proven children through the table. The attacker plays any move
+    /// which was proven, while the defender plays the move whose proof took the
+    /// most work, which is the most stubborn defence. Stops at a missing Entry
+
+    Board *const board = &thread->board;
+    uint16_t moves[MAX_MOVES];
+    uint32_t pn, dn;
+
+    pv->length = 0;
+
+    for (bool attacker = true; left > 0; left--, attacker = !attacker) {
+
+        uint16_t chosen = NONE_MOVE;
+        uint64_t most = 0;
+        int size = mate_moves(thread, left, attacker, moves);
+
+        for (int i = 0; i < size; i++) {
+
+            applyLegal(thread, board, moves[i]);
+            uint64_t key = mate_key(board->hash, left - 1);
+            bool proven = mate_probe(key, &pn, &dn) && pn == 0;
+            revert(thread, board, moves[i]);
+
+            if (!proven) continue;
+
+            MateEntry *bucket = &MateTable[2 * (key & MateMask)];
+            uint64_t work = bucket[0].key == key ? bucket[0].work : bucket[1].work;
+
+            if (chosen == NONE_MOVE || (!attacker && work > most))
+                chosen = moves[i], most = work;
+
+            if (attacker) break;
+        }
+
+        if (chosen == NONE_MOVE) break;
+
+        pv->line[pv->length++] = chosen;
+        applyLegal(thread, board, chosen);
+    }
+
+    // Return the board to the root
+    for (int i = pv->length - 1; i >= 0; i--)
+        revert(thread, board, pv->line[i]);
+}
+
+static uint16_t mate_most_proving(Thread *thread, int left) {
+
+    // Without a proof, suggest the root move closest to one
+    Board *const board = &thread->board;
+    uint16_t moves[MAX_MOVES], best = NONE_MOVE;
+    uint32_t pn, dn, lowest = MATE_INFINITY + 1;
+
+    int size = genAllLegalMoves(board, moves);
+
+    for (int i = 0; i < size; i++) {
+        applyLegal(thread, board, moves[i]);
+        mate_probe(mate_key(board->hash, left - 1), &pn, &dn);
+        revert(thread, board, moves[i]);
+        if (pn < lowest) best = moves[i], lowest = pn;
+    }
+
+    return best;
+}
+
+void mateSearch(Thread *threads, Board *board, Limits *limits, uint16_t *best, uint16_t *ponder, int *score) {
+
+    /// Look for the shortest mate of at most limits->mateLimit moves, searching
+    /// for a mate in 1, then 2, and so on. Each proven mate is exact, since all
+    /// shorter mates were already disproven. Only the main Thread is used
+
+    TimeManager tm = {0}; tm_init(limits, &tm);
+    Thread *const thread = &threads[0];
+    PVariation pv = {0};
+    uint32_t pn = MATE_INFINITY, dn = 0;
+    int moves = 1;
+
+    ABORT_SIGNAL = 0; // Otherwise the search would stop at once
+    MateStopped = false, MatePolls = 0;
+    newSearchThreadPool(threads, board, limits, &tm);
+    mate_table_init();
+
+    thread->multiPV = 0; // Reported as the only line
+
+    *best = *ponder = NONE_MOVE, *score = 0;
+
+    for (; moves <= MIN(limits->mateLimit, MATE_MAX_MOVES); moves++) {
+
+        thread->depth = thread->seldepth = 2 * moves - 1;
+        mate_dfpn(thread, 2 * moves - 1, true, MATE_INFINITY, MATE_INFINITY, &pn, &dn);
+
+        if (pn == 0 || MateStopped) break;
+    }
+
+    if (pn == 0) {
+
+        mate_principal_variation(thread, 2 * moves - 1, &pv);
+        pv.score = MATE - (2 * moves - 1);
+        uciReport(threads, &pv, -MATE, MATE);
+
+        *best   = pv.length > 0 ? pv.line[0] : NONE_MOVE;
+        *ponder = pv.length > 1 ? pv.line[1] : NONE_MOVE;
+        *score  = pv.score;
+    }
+
+    else {
+        printf("info string no mate in %d found\n", moves - !MateStopped);
+        fflush(stdout);
+        *best = mate_most_proving(thread, 2 * MIN(moves, MATE_MAX_MOVES) - 1);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "types.h"
+
+/// "go mate N" is answered by a depth-first proof-number search (df-pn), rather
+/// than by the regular search with all of its pruning. Every position carries a
+/// proof number and a disproof number, the least number of leaves which must be
+/// shown to be mate, or shown to not be mate, to settle the position. The search
+/// always expands the most proving leaf, and only backs out of a subtree once it
+/// exceeds the thresholds given by its parent. Positions are keyed by their hash
+/// and the number of plies remaining, and kept in a table of MateHash megabytes,
+/// replacing the Entries which took the least work to compute
+
+enum {
+    MATE_INFINITY  = 1 << 30,
+    MATE_MAX_MOVES = 60,
+};
+
+struct MateEntry {
+    uint64_t key;
+    uint32_t pn, dn;
+    uint64_t work;
+};
+
+void mateSearch(Thread *threads, Board *board, Limits *limits, uint16_t *best, uint16_t *ponder, int *score);
@@ -71,6 +71,11 @@ int apply(Thread *thread, Board *board, uint16_t move) {
 
     else {
 
+        // The Move Picker yields pseudo legal moves, and the search's move
+        // counts include the illegal ones. Reject those without making them
+        if (!pseudoLegalMoveIsLegal(board, move))
+            return 0;
+
         ns->movedPiece    = pieceType(board->squares[MoveFrom(move)]);
         ns->tactical      = moveIsTactical(board, move);
         ns->continuations = &thread->continuation[ns->tactical][ns->movedPiece][MoveTo(move)];
@@ -79,10 +84,7 @@ int apply(Thread *thread, Board *board, uint16_t move) {
         // Prefetch the next tt-entry as soon as we have the Key
         applyMove(board, move, &thread->undoStack[thread->height]);
         tt_prefetch(board->hash);
-
-        // Reject the move if it was illegal
-        if (!moveWasLegal(board))
-            return revertMove(board, move, &thread->undoStack[thread->height]), 0;
+        assert(moveWasLegal(board));
     }
 
     // Advance the Stack before updating
@@ -116,14 +118,16 @@ void applyMove(Board *board, uint16_t move, Undo *undo) {
     };
 
     // Save information which is hard to recompute
-    undo->hash            = board->hash;
-    undo->pkhash          = board->pkhash;
-    undo->kingAttackers   = board->kingAttackers;
-    undo->threats         = board->threats;
-    undo->castleRooks     = board->castleRooks;
-    undo->epSquare        = board->epSquare;
-    undo->halfMoveCounter = board->halfMoveCounter;
-    undo->psqtmat         = board->psqtmat;
+    undo->hash               = board->hash;
+    undo->pkhash             = board->pkhash;
+    undo->kingAttackers      = board->kingAttackers;
+    undo->threats            = board->threats;
+    undo->validKingAttackers = board->validKingAttackers;
+    undo->validThreats       = board->validThreats;
+    undo->castleRooks        = board->castleRooks;
+    undo->epSquare           = board->epSquare;
+    undo->halfMoveCounter    = board->halfMoveCounter;
+    undo->psqtmat            = board->psqtmat;
 
     // Store hash history for repetition checking
     board->history[board->numMoves++] = board->hash;
@@ -143,11 +147,8 @@ void applyMove(Board *board, uint16_t move, Undo *undo) {
     // No function updates this so we do it here
     board->turn = !board->turn;
 
-    // Need king attackers for move generation
-    board->kingAttackers = attackersToKingSquare(board);
-
-    // Need squares attacked by the opposing player
-    board->threats = allAttackedSquares(board, !board->turn);
+    // King attackers and threats are computed once they are needed
+    board->validKingAttackers = board->validThreats = 0;
 }
 
 void applyNormalMove(Board *board, uint16_t move, Undo *undo) {
@@ -361,10 +362,13 @@ void applyPromotionMove(Board *board, uint16_t move, Undo *undo) {
 void applyNullMove(Board *board, Undo *undo) {
 
     // Save information which is hard to recompute
-    undo->hash            = board->hash;
-    undo->threats         = board->threats;
-    undo->epSquare        = board->epSquare;
-    undo->halfMoveCounter = board->halfMoveCounter++;
+    undo->hash               = board->hash;
+    undo->kingAttackers      = board->kingAttackers;
+    undo->threats            = board->threats;
+    undo->validKingAttackers = board->validKingAttackers;
+    undo->validThreats       = board->validThreats;
+    undo->epSquare           = board->epSquare;
+    undo->halfMoveCounter    = board->halfMoveCounter++;
 
     // NULL moves simply swap the turn only
     board->turn = !board->turn;
@@ -378,7 +382,10 @@ void applyNullMove(Board *board, Undo *undo) {
         board->epSquare = -1;
     }
 
-    board->threats = allAttackedSquares(board, !board->turn);
+    // Threats are computed once they are needed. A NULL move
+    // is never made when in check, so there are no attackers
+    board->kingAttackers = 0ull, board->validKingAttackers = 1;
+    board->validThreats  = 0;
 }
 
 
@@ -396,14 +403,16 @@ void revertMove(Board *board, uint16_t move, Undo *undo) {
     const int from = MoveFrom(move);
 
     // Revert information which is hard to recompute
-    board->hash            = undo->hash;
-    board->pkhash          = undo->pkhash;
-    board->kingAttackers   = undo->kingAttackers;
-    board->threats         = undo->threats;
-    board->castleRooks     = undo->castleRooks;
-    board->epSquare        = undo->epSquare;
-    board->halfMoveCounter = undo->halfMoveCounter;
-    board->psqtmat         = undo->psqtmat;
+    board->hash               = undo->hash;
+    board->pkhash             = undo->pkhash;
+    board->kingAttackers      = undo->kingAttackers;
+    board->threats            = undo->threats;
+    board->validKingAttackers = undo->validKingAttackers;
+    board->validThreats       = undo->validThreats;
+    board->castleRooks        = undo->castleRooks;
+    board->epSquare           = undo->epSquare;
+    board->halfMoveCounter    = undo->halfMoveCounter;
+    board->psqtmat            = undo->psqtmat;
 
     // Swap turns and update the history index
     board->turn = !board->turn;
@@ -486,10 +495,13 @@ void revertMove(Board *board, uint16_t move, Undo *undo) {
 void revertNullMove(Board *board, Undo *undo) {
 
     // Revert information which is hard to recompute
-    board->hash            = undo->hash;
-    board->threats         = undo->threats;
-    board->epSquare        = undo->epSquare;
-    board->halfMoveCounter = undo->halfMoveCounter;
+    board->hash               = undo->hash;
+    board->kingAttackers      = undo->kingAttackers;
+    board->threats            = undo->threats;
+    board->validKingAttackers = undo->validKingAttackers;
+    board->validThreats       = undo->validThreats;
+    board->epSquare           = undo->epSquare;
+    board->halfMoveCounter    = undo->halfMoveCounter;
 
     // NULL moves simply swap the turn only
     board->turn = !board->turn;
@@ -520,10 +532,21 @@ int moveExaminedByMultiPV(Thread *thread, uint16_t move) {
 
 int moveIsInRootMoves(Thread *thread, uint16_t move) {
 
-    // We do two things: 1) Check to make sure we are not using a move which
+    // We do three things: 1) Check to make sure we are not using a move which
     // has been flagged as excluded thanks to Syzygy probing. 2) Check to see
     // if we are doing a "go searchmoves <>"  command, in which case we have
-    // to limit our search to the provided moves.
+    // to limit our search to the provided moves. 3) Check to see if we are in
+    // a split MultiPV search, where each Thread owns a share of the moves.
+
+    if (thread->rootCount) {
+
+        int owned = 0;
+
+        for (int i = 0; i < thread->rootCount && !owned; i++)
+            owned = move == thread->rootMoves[i];
+
+        if (!owned) return 0;
+    }
 
     for (int i = 0; i < MAX_MOVES; i++)
         if (move == thread->limits->excludedMoves[i])
@@ -593,17 +616,8 @@ int moveBestCaseValue(Board *board) {
 }
 
 int moveIsLegal(Board *board, uint16_t move) {
-
-    int legal; Undo undo;
-
-    if (!moveIsPseudoLegal(board, move))
-        return 0;
-
-    applyMove(board, move, &undo);
-    legal = moveWasLegal(board);
-    revertMove(board, move, &undo);
-
-    return legal;
+    return moveIsPseudoLegal(board, move)
+        && pseudoLegalMoveIsLegal(board, move);
 }
 
 int moveIsPseudoLegal(Board *board, uint16_t move) {
@@ -694,7 +708,7 @@ int moveIsPseudoLegal(Board *board, uint16_t move) {
     // player. If one matches, we can then verify the pseudo legality
     // using the same code as from movegen.c
 
-    while (castles && !board->kingAttackers) {
+    while (castles && !boardKingAttackers(board)) {
 
         // Figure out which pieces are moving to which squares
         rook = poplsb(&castles), king = from;
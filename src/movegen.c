@@ -89,25 +89,161 @@ uint16_t* buildSliderMoves(SliderFunc F, uint16_t *moves, uint64_t pieces, uint6
     return moves;
 }
 
+uint16_t* buildPinnedMoves(SliderFunc F, uint16_t *moves, uint64_t pieces, uint64_t targets, uint64_t occupied, uint64_t *rays) {
 
-int genAllLegalMoves(Board *board, uint16_t *moves) {
+    // Pinned pieces may only move along the ray between the King and the pinner
+    while (pieces) {
+        int sq = poplsb(&pieces);
+        moves = buildNormalMoves(moves, F(sq, occupied) & targets & rays[sq], sq);
+    }
+
+    return moves;
+}
 
-    Undo undo[1];
-    int size = 0, pseudo = 0;
-    uint16_t pseudoMoves[MAX_MOVES];
+uint16_t* buildKingMoves(Board *board, uint16_t *moves, int king, uint64_t targets) {
 
-    // Call genAllNoisyMoves() & genAllNoisyMoves()
-    pseudo  = genAllNoisyMoves(board, pseudoMoves);
-    pseudo += genAllQuietMoves(board, pseudoMoves + pseudo);
+    // Remove the King, so that squares behind it on a checking ray are attacked
+    uint64_t occupied = (board->colours[WHITE] | board->colours[BLACK]) ^ (1ull << king);
+    uint64_t attacks  = kingAttacks(king) & targets;
 
-    // Check each move for legality before copying
-    for (int i = 0; i < pseudo; i++) {
-        applyMove(board, pseudoMoves[i], undo);
-        if (moveWasLegal(board)) moves[size++] = pseudoMoves[i];
-        revertMove(board, pseudoMoves[i], undo);
+    while (attacks) {
+        int sq = poplsb(&attacks);
+        if (!squareIsAttackedWith(board, board->turn, sq, occupied))
+            *(moves++) = MoveMake(king, sq, NORMAL_MOVE);
     }
 
-    return size;
+    return moves;
+}
+
+uint16_t* buildNoisyPawnMoves(Board *board, uint16_t *moves, uint64_t pawns, uint64_t mask) {
+
+    const int Left    = board->turn == WHITE ? -7 : 7;
+    const int Right   = board->turn == WHITE ? -9 : 9;
+    const int Forward = board->turn == WHITE ? -8 : 8;
+
+    uint64_t them     = board->colours[!board->turn];
+    uint64_t occupied = board->colours[board->turn] | them;
+
+    // Compute bitboards for each type of Pawn movement
+    uint64_t pawnLeft         = pawnLeftAttacks(pawns, them & mask, board->turn);
+    uint64_t pawnRight        = pawnRightAttacks(pawns, them & mask, board->turn);
+    uint64_t pawnPromoForward = pawnAdvance(pawns, occupied, board->turn) & PROMOTION_RANKS & mask;
+    uint64_t pawnPromoLeft    = pawnLeft & PROMOTION_RANKS; pawnLeft &= ~PROMOTION_RANKS;
+    uint64_t pawnPromoRight   = pawnRight & PROMOTION_RANKS; pawnRight &= ~PROMOTION_RANKS;
+
+    // Generate moves for all the Pawns, so long as they are noisy
+    moves = buildPawnMoves(moves, pawnLeft, Left);
+    moves = buildPawnMoves(moves, pawnRight, Right);
+    moves = buildPawnPromotions(moves, pawnPromoForward, Forward);
+    moves = buildPawnPromotions(moves, pawnPromoLeft, Left);
+    moves = buildPawnPromotions(moves, pawnPromoRight, Right);
+
+    return moves;
+}
+
+uint16_t* buildQuietPawnMoves(Board *board, uint16_t *moves, uint64_t pawns, uint64_t mask) {
+
+    const int Forward = board->turn == WHITE ? -8 : 8;
+    const uint64_t Rank3Relative = board->turn == WHITE ? RANK_3 : RANK_6;
+
+    uint64_t occupied = board->colours[WHITE] | board->colours[BLACK];
+
+    // Compute bitboards for each type of Pawn movement
+    uint64_t pawnForwardOne = pawnAdvance(pawns, occupied, board->turn) & ~PROMOTION_RANKS;
+    uint64_t pawnForwardTwo = pawnAdvance(pawnForwardOne & Rank3Relative, occupied, board->turn);
+
+    // Generate moves for all the pawns, so long as they are quiet
+    moves = buildPawnMoves(moves, pawnForwardOne & mask, Forward);
+    moves = buildPawnMoves(moves, pawnForwardTwo & mask, Forward * 2);
+
+    return moves;
+}
+
+static uint64_t pinnedPieces(Board *board, int king, uint64_t *rays) {
+
+    /// Find our pieces which are the only blocker between our King and an
+    /// enemy slider. Each pinned piece is given the ray which it may still
+    /// move along, from the King up to and including the pinning piece
+
+    uint64_t us       = board->colours[ board->turn];
+    uint64_t them     = board->colours[!board->turn];
+    uint64_t occupied = us | them;
+    uint64_t pinned   = 0ull;
+
+    uint64_t snipers = them & (
+        (rookAttacks(king, 0ull) & (board->pieces[ROOK] | board->pieces[QUEEN]))
+      | (bishopAttacks(king, 0ull) & (board->pieces[BISHOP] | board->pieces[QUEEN])));
+
+    while (snipers) {
+
+        int sq = poplsb(&snipers);
+        uint64_t blockers = bitsBetweenMasks(king, sq) & occupied;
+
+        if (onlyOne(blockers) && (blockers & us)) {
+            pinned |= blockers;
+            rays[getlsb(blockers)] = bitsBetweenMasks(king, sq) | (1ull << sq);
+        }
+    }
+
+    return pinned;
+}
+
+static uint64_t checkEvasionMask(Board *board, int king) {
+
+    // When in check, non-King moves must capture the checker or block it
+    const uint64_t checkers = boardKingAttackers(board);
+    return !checkers ? ~0ull : checkers | bitsBetweenMasks(king, getlsb(checkers));
+}
+
+static int enpassIsLegal(Board *board, int from, int king) {
+
+    // Enpass removes two pieces from a rank, which can reveal an attack on
+    // our King that the pins do not cover, so verify against the new board
+    const int captured = board->epSquare + (board->turn == WHITE ? -8 : 8);
+
+    uint64_t occupied = board->colours[WHITE] | board->colours[BLACK];
+    occupied = (occupied ^ (1ull << from) ^ (1ull << captured)) | (1ull << board->epSquare);
+
+    return !squareIsAttackedWith(board, board->turn, king, occupied);
+}
+
+static int castleIsLegal(Board *board, int king, int rook) {
+
+    /// Castles are legal if the King and Rook have empty paths, and the King
+    /// neither passes over nor lands on an attacked square. The landing square
+    /// is checked with both pieces moved, since in Chess960 the Rook may have
+    /// been shielding the King's destination from an enemy slider
+
+    const int rookTo = castleRookTo(king, rook);
+    const int kingTo = castleKingTo(king, rook);
+
+    uint64_t occupied = board->colours[WHITE] | board->colours[BLACK];
+    uint64_t mask;
+
+    // Castle is illegal if we would go over a piece
+    mask  = bitsBetweenMasks(king, kingTo) | (1ull << kingTo);
+    mask |= bitsBetweenMasks(rook, rookTo) | (1ull << rookTo);
+    mask &= ~((1ull << king) | (1ull << rook));
+    if (occupied & mask) return 0;
+
+    // Castle is illegal if we move through a checking threat
+    mask = bitsBetweenMasks(king, kingTo);
+    while (mask)
+        if (squareIsAttacked(board, board->turn, poplsb(&mask)))
+            return 0;
+
+    // Castle is illegal if we would end up in check
+    occupied = (occupied ^ (1ull << king) ^ (1ull << rook)) | (1ull << rookTo);
+    return !squareIsAttackedWith(board, board->turn, kingTo, occupied);
+}
+
+
+
+int genAllLegalMoves(Board *board, uint16_t *moves) {
+
+    // Both generators only produce legal moves
+    int size = genLegalNoisyMoves(board, moves);
+    return size + genLegalQuietMoves(board, moves + size);
 }
 
 int genAllNoisyMoves(Board *board, uint16_t *moves) {
@@ -136,11 +272,11 @@ int genAllNoisyMoves(Board *board, uint16_t *moves) {
     rooks   |= us & board->pieces[QUEEN];
 
     // Double checks can only be evaded by moving the King
-    if (several(board->kingAttackers))
+    if (several(boardKingAttackers(board)))
         return buildJumperMoves(&kingAttacks, moves, kings, them) - start;
 
     // When checked, we may only uncheck by capturing the checker
-    destinations = board->kingAttackers ? board->kingAttackers : them;
+    destinations = boardKingAttackers(board) ? boardKingAttackers(board) : them;
 
     // Compute bitboards for each type of Pawn movement
     pawnEnpass       = pawnEnpassCaptures(pawns, board->epSquare, board->turn);
@@ -192,12 +328,12 @@ int genAllQuietMoves(Board *board, uint16_t *moves) {
     rooks   |= us & board->pieces[QUEEN];
 
     // Double checks can only be evaded by moving the King
-    if (several(board->kingAttackers))
+    if (several(boardKingAttackers(board)))
         return buildJumperMoves(&kingAttacks, moves, kings, ~occupied) - start;
 
     // When checked, we must block the checker with non-King pieces
-    destinations = !board->kingAttackers ? ~occupied
-                 : bitsBetweenMasks(getlsb(kings), getlsb(board->kingAttackers));
+    destinations = !boardKingAttackers(board) ? ~occupied
+                 : bitsBetweenMasks(getlsb(kings), getlsb(boardKingAttackers(board)));
 
     // Compute bitboards for each type of Pawn movement
     pawnForwardOne = pawnAdvance(pawns, occupied, board->turn) & ~PROMOTION_RANKS;
@@ -214,7 +350,7 @@ int genAllQuietMoves(Board *board, uint16_t *moves) {
     moves = buildJumperMoves(&kingAttacks, moves, kings, ~occupied);
 
     // Attempt to generate a castle move for each rook
-    while (castles && !board->kingAttackers) {
+    while (castles && !boardKingAttackers(board)) {
 
         // Figure out which pieces are moving to which squares
         rook = poplsb(&castles), king = getlsb(kings);
@@ -241,3 +377,145 @@ int genAllQuietMoves(Board *board, uint16_t *moves) {
 
     return moves - start;
 }
+
+int genLegalNoisyMoves(Board *board, uint16_t *moves) {
+
+    const uint16_t *start = moves;
+
+    uint64_t rays[SQUARE_NB], pinned, mask, targets, pawnEnpass;
+
+    uint64_t us       = board->colours[board->turn];
+    uint64_t them     = board->colours[!board->turn];
+    uint64_t occupied = us | them;
+
+    uint64_t pawns   = us & (board->pieces[PAWN  ]);
+    uint64_t knights = us & (board->pieces[KNIGHT]);
+    uint64_t bishops = us & (board->pieces[BISHOP]);
+    uint64_t rooks   = us & (board->pieces[ROOK  ]);
+    uint64_t kings   = us & (board->pieces[KING  ]);
+
+    const int king = getlsb(kings);
+
+    // Merge together duplicate piece ideas
+    bishops |= us & board->pieces[QUEEN];
+    rooks   |= us & board->pieces[QUEEN];
+
+    // Double checks can only be evaded by moving the King
+    if (several(boardKingAttackers(board)))
+        return buildKingMoves(board, moves, king, them) - start;
+
+    // When checked, we may only uncheck by capturing the checker
+    mask    = checkEvasionMask(board, king);
+    targets = them & mask;
+    pinned  = pinnedPieces(board, king, rays);
+
+    // Enpass captures are rare, so we verify each against the resulting board
+    pawnEnpass = pawnEnpassCaptures(pawns, board->epSquare, board->turn);
+    for (uint64_t bb = pawnEnpass; bb; ) {
+        int sq = poplsb(&bb);
+        if (!enpassIsLegal(board, sq, king)) pawnEnpass ^= 1ull << sq;
+    }
+
+    // Generate moves for all the Pawns, so long as they are noisy
+    moves = buildEnpassMoves(moves, pawnEnpass, board->epSquare);
+    moves = buildNoisyPawnMoves(board, moves, pawns & ~pinned, mask);
+    for (uint64_t bb = pawns & pinned; bb; ) {
+        int sq = poplsb(&bb);
+        moves = buildNoisyPawnMoves(board, moves, 1ull << sq, mask & rays[sq]);
+    }
+
+    // Generate moves for the remainder of the pieces, so long as they are noisy.
+    // Pinned Knights can never move, as they would always leave the pinning ray
+    moves = buildJumperMoves(&knightAttacks, moves, knights & ~pinned, targets);
+    moves = buildSliderMoves(&bishopAttacks, moves, bishops & ~pinned, targets, occupied);
+    moves = buildSliderMoves(&rookAttacks, moves, rooks & ~pinned, targets, occupied);
+    moves = buildPinnedMoves(&bishopAttacks, moves, bishops & pinned, targets, occupied, rays);
+    moves = buildPinnedMoves(&rookAttacks, moves, rooks & pinned, targets, occupied, rays);
+    moves = buildKingMoves(board, moves, king, them);
+
+    return moves - start;
+}
+
+int genLegalQuietMoves(Board *board, uint16_t *moves) {
+
+    const uint16_t *start = moves;
+
+    uint64_t rays[SQUARE_NB], pinned, targets;
+
+    uint64_t us       = board->colours[board->turn];
+    uint64_t occupied = us | board->colours[!board->turn];
+    uint64_t castles  = us & board->castleRooks;
+
+    uint64_t pawns   = us & (board->pieces[PAWN  ]);
+    uint64_t knights = us & (board->pieces[KNIGHT]);
+    uint64_t bishops = us & (board->pieces[BISHOP]);
+    uint64_t rooks   = us & (board->pieces[ROOK  ]);
+    uint64_t kings   = us & (board->pieces[KING  ]);
+
+    const int king = getlsb(kings);
+
+    // Merge together duplicate piece ideas
+    bishops |= us & board->pieces[QUEEN];
+    rooks   |= us & board->pieces[QUEEN];
+
+    // Double checks can only be evaded by moving the King
+    if (several(boardKingAttackers(board)))
+        return buildKingMoves(board, moves, king, ~occupied) - start;
+
+    // When checked, we must block the checker with non-King pieces
+    targets = ~occupied & checkEvasionMask(board, king);
+    pinned  = pinnedPieces(board, king, rays);
+
+    // Generate moves for all the pawns, so long as they are quiet
+    moves = buildQuietPawnMoves(board, moves, pawns & ~pinned, targets);
+    for (uint64_t bb = pawns & pinned; bb; ) {
+        int sq = poplsb(&bb);
+        moves = buildQuietPawnMoves(board, moves, 1ull << sq, targets & rays[sq]);
+    }
+
+    // Generate moves for the remainder of the pieces, so long as they are quiet
+    moves = buildJumperMoves(&knightAttacks, moves, knights & ~pinned, targets);
+    moves = buildSliderMoves(&bishopAttacks, moves, bishops & ~pinned, targets, occupied);
+    moves = buildSliderMoves(&rookAttacks, moves, rooks & ~pinned, targets, occupied);
+    moves = buildPinnedMoves(&bishopAttacks, moves, bishops & pinned, targets, occupied, rays);
+    moves = buildPinnedMoves(&rookAttacks, moves, rooks & pinned, targets, occupied, rays);
+    moves = buildKingMoves(board, moves, king, ~occupied);
+
+    // Attempt to generate a castle move for each rook
+    while (castles && !boardKingAttackers(board)) {
+        int rook = poplsb(&castles);
+        if (castleIsLegal(board, king, rook))
+            *(moves++) = MoveMake(king, rook, CASTLE_MOVE);
+    }
+
+    return moves - start;
+}
+
+int pseudoLegalMoveIsLegal(Board *board, uint16_t move) {
+
+    /// Legality of a move already known to be pseudo legal, using the same
+    /// pins and check evasions as the generators, so without applying it
+
+    uint64_t rays[SQUARE_NB];
+
+    const int from = MoveFrom(move), to = MoveTo(move);
+    const int king = getlsb(board->colours[board->turn] & board->pieces[KING]);
+
+    if (MoveType(move) == CASTLE_MOVE)
+        return castleIsLegal(board, king, to);
+
+    if (MoveType(move) == ENPASS_MOVE)
+        return enpassIsLegal(board, from, king);
+
+    // The King may move to any square which is not attacked once it has left
+    if (from == king) {
+        uint64_t occupied = board->colours[WHITE] | board->colours[BLACK];
+        return !squareIsAttackedWith(board, board->turn, to, occupied ^ (1ull << king));
+    }
+
+    // Everything else must resolve any check, and stay on any pinning ray
+    return !several(boardKingAttackers(board))
+        &&  testBit(checkEvasionMask(board, king), to)
+        && (   !testBit(pinnedPieces(board, king, rays), from)
+            ||  testBit(rays[from], to));
+}
@@ -25,3 +25,6 @@
 int genAllLegalMoves(Board *board, uint16_t *moves);
 int genAllNoisyMoves(Board *board, uint16_t *moves);
 int genAllQuietMoves(Board *board, uint16_t *moves);
+int genLegalNoisyMoves(Board *board, uint16_t *moves);
+int genLegalQuietMoves(Board *board, uint16_t *moves);
+int pseudoLegalMoveIsLegal(Board *board, uint16_t move);
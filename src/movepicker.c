@@ -16,6 +16,10 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#if defined(USE_SSSE3)
+    #include <immintrin.h>
+#endif
+
 #include "board.h"
 #include "history.h"
 #include "move.h"
@@ -31,12 +35,74 @@ static uint16_t pop_move(int *size, uint16_t *moves, int *values, int index) {
     return popped;
 }
 
+extern int HelperMoveNoise; // Defined by search.c
+
+static void perturb_quiets(Thread *thread, uint16_t *moves, int *values, int start, int length) {
+
+    /// Helpers add a small deterministic noise to the history of each quiet
+    /// move near the root, so that they explore the tree in differing orders
+
+    for (int i = start; i < start + length; i++) {
+        uint64_t x = thread->board.hash ^ (moves[i] * 0x9E3779B97F4A7C15ull) ^ thread->index;
+        x = (x ^ (x >> 31)) * 0xBF58476D1CE4E5B9ull;
+        values[i] += (int) ((x >> 32) % (2 * HelperMoveNoise + 1)) - HelperMoveNoise;
+    }
+}
+
 static int best_index(MovePicker *mp, int start, int end) {
 
+    /// Index of the first of the highest values in [start, end). With AVX2 or
+    /// SSE4.1, the maximum is reduced eight or four values at a time, and then
+    /// located with an equality mask. The final loads overlap the values which
+    /// came before them, rather than handling the remainder one at a time
+
+    const int *values = mp->values;
+
+#if defined(USE_AVX2)
+
+    if (end - start >= 8) {
+
+        __m256i vmax = _mm256_loadu_si256((const __m256i*) &values[end - 8]);
+        for (int i = start; i < end - 8; i += 8)
+            vmax = _mm256_max_epi32(vmax, _mm256_loadu_si256((const __m256i*) &values[i]));
+
+        __m128i hmax = _mm_max_epi32(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+        hmax = _mm_max_epi32(hmax, _mm_shuffle_epi32(hmax, 0x4E));
+        hmax = _mm_max_epi32(hmax, _mm_shuffle_epi32(hmax, 0xB1));
+        const __m256i needle = _mm256_broadcastd_epi32(hmax);
+
+        for (int i = start; ; i = MIN(i + 8, end - 8)) {
+            const __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) &values[i]), needle);
+            const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+            if (mask) return i + __builtin_ctz(mask);
+        }
+    }
+
+#elif defined(USE_AVX)
+
+    if (end - start >= 4) {
+
+        __m128i vmax = _mm_loadu_si128((const __m128i*) &values[end - 4]);
+        for (int i = start; i < end - 4; i += 4)
+            vmax = _mm_max_epi32(vmax, _mm_loadu_si128((const __m128i*) &values[i]));
+
+        vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, 0x4E));
+        vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, 0xB1));
+        const __m128i needle = _mm_shuffle_epi32(vmax, 0x00);
+
+        for (int i = start; ; i = MIN(i + 4, end - 4)) {
+            const __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) &values[i]), needle);
+            const int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+            if (mask) return i + __builtin_ctz(mask);
+        }
+    }
+
+#endif
+
     int best = start;
 
     for (int i = start + 1; i < end; i++)
-        if (mp->values[i] > mp->values[best])
+        if (values[i] > values[best])
             best = i;
 
     return best;
@@ -189,6 +255,9 @@ uint16_t select_next(MovePicker *mp, Thread *thread, int skip_quiets) {
             if (!skip_quiets) {
                 mp->quiet_size = genAllQuietMoves(board, mp->moves + mp->split);
                 get_quiet_histories(thread, mp->moves, mp->values, mp->split, mp->quiet_size);
+
+                if (HelperMoveNoise && thread->index && thread->height <= 2)
+                    perturb_quiets(thread, mp->moves, mp->values, mp->split, mp->quiet_size);
             }
 
             mp->stage = STAGE_QUIET;
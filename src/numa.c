@@ -0,0 +1,152 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+    #define _GNU_SOURCE
+    #include <sched.h>
+#endif
+
+#if !defined(_WIN32)
+    #include <unistd.h>
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "numa.h"
+#include "types.h"
+
+#if !defined(__linux__) || defined(__ANDROID__)
+
+void numa_init() {}
+int numa_node_count() { return 1; }
+
+int numa_cpu_count() {
+#if defined(_SC_NPROCESSORS_ONLN)
+    return MAX(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+#else
+    return 1;
+#endif
+}
+
+int numa_cpu_node(int cpu) { (void) cpu; return 0; }
+int numa_thread_node() { return -1; }
+bool numa_bind_node(int node) { (void) node; return false; }
+
+#else
+
+static int NodeCount = 1;
+static cpu_set_t NodeCPUs[NUMA_MAX_NODES];
+static int CPUNodes[CPU_SETSIZE];
+
+static bool parse_cpulist(const char *fname, cpu_set_t *set) {
+
+    /// Parse a sysfs cpulist, such as "0-15,32-47", into a CPU set. Returns
+    /// false if the file is missing, or if it does not list any CPUs at all
+
+    int first, last, sep;
+    FILE *fin = fopen(fname, "r");
+
+    if (fin == NULL) return false;
+
+    CPU_ZERO(set);
+
+    while (fscanf(fin, "%d", &first) == 1) {
+
+        last = first;
+
+        if ((sep = fgetc(fin)) == '-') {
+            if (fscanf(fin, "%d", &last) != 1) break;
+            sep = fgetc(fin);
+        }
+
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, set);
+
+        if (sep != ',') break;
+    }
+
+    fclose(fin);
+    return CPU_COUNT(set) > 0;
+}
+
+void numa_init() {
+
+    char fname[256];
+
+    // Nodes may be sparsely numbered, and some nodes may only hold memory
+    NodeCount = 0;
+    for (int node = 0; node < 1024 && NodeCount < NUMA_MAX_NODES; node++) {
+        sprintf(fname, "/sys/devices/system/node/node%d/cpulist", node);
+        if (parse_cpulist(fname, &NodeCPUs[NodeCount])) NodeCount++;
+    }
+
+    // Without sysfs, treat all of the CPUs available to us as one node
+    if (NodeCount == 0) {
+        NodeCount = 1;
+        sched_getaffinity(0, sizeof(cpu_set_t), &NodeCPUs[0]);
+    }
+
+    // Build the reverse lookup to find the node for any given CPU
+    for (int node = 0; node < NodeCount; node++)
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &NodeCPUs[node])) CPUNodes[cpu] = node;
+}
+
+int numa_cpu_count() {
+
+    // Count the CPUs which this process is permitted to run on
+    cpu_set_t mask;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &mask))
+        return MAX(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+
+    return MAX(1, CPU_COUNT(&mask));
+}
+
+int numa_node_count() {
+    return NodeCount;
+}
+
+int numa_cpu_node(int cpu) {
+    return 0 <= cpu && cpu < CPU_SETSIZE ? CPUNodes[cpu] : 0;
+}
+
+int numa_thread_node() {
+
+    /// Return the node which the calling thread has been bound to, or -1 if the
+    /// affinity of the thread allows it to be scheduled on more than one node
+
+    cpu_set_t mask, overlap;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &mask)) return -1;
+
+    for (int node = 0; node < NodeCount; node++) {
+        CPU_AND(&overlap, &mask, &NodeCPUs[node]);
+        if (CPU_EQUAL(&overlap, &mask)) return node;
+    }
+
+    return -1;
+}
+
+bool numa_bind_node(int node) {
+    return 0 <= node && node < NodeCount
+        && !sched_setaffinity(0, sizeof(cpu_set_t), &NodeCPUs[node]);
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "types.h"
+
+/// Ethereal discovers the NUMA topology of Linux hosts by reading sysfs, so that
+/// there is no dependency on libnuma. Every node with at least one CPU is given
+/// a dense index, starting from zero. On other Operating Systems, or when sysfs
+/// is not available, the machine is treated as a single node containing all CPUs
+
+enum { NUMA_OFF, NUMA_INTERLEAVE, NUMA_LOCAL };
+
+enum { NUMA_MAX_NODES = 64 };
+
+enum { AFFINITY_OFF, AFFINITY_COMPACT, AFFINITY_SPREAD };
+
+#ifndef USE_NUMA
+    #define USE_NUMA 0
+#endif
+
+void numa_init();
+int numa_cpu_count();
+int numa_node_count();
+int numa_cpu_node(int cpu);
+int numa_thread_node();
+bool numa_bind_node(int node);
@@ -0,0 +1,153 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "move.h"
+#include "movegen.h"
+#include "perft.h"
+#include "types.h"
+
+typedef struct PerftJob {
+    Board board;
+    int depth, size;
+    uint16_t *moves;
+    uint64_t *counts;
+    atomic_int *next;
+} PerftJob;
+
+static PerftEntry *PerftTable; // Lockless Entries, shared by every Thread
+static uint64_t PerftMask;     // Mask of the Entry index, for the current PerftTable
+static int PerftTableMB;       // Megabytes of the current PerftTable, to detect resizes
+static bool PerftHashing;      // Set when the current call was given a table size
+
+static uint64_t perft_key(uint64_t hash, int depth) {
+    return hash ^ (0x9E3779B97F4A7C15ull * (uint64_t) depth);
+}
+
+static uint64_t perft_recurse(Board *board, int depth) {
+
+    Undo undo[1];
+    uint64_t found = 0ull, key = 0ull;
+    uint16_t moves[MAX_MOVES];
+
+    int size = genAllLegalMoves(board, moves);
+
+    // Bulk count the final ply, as every generated move is legal
+    if (depth == 1) return size;
+
+    if (PerftHashing && depth >= PERFT_HASH_DEPTH) {
+
+        key = perft_key(board->hash, depth);
+        PerftEntry *entry = &PerftTable[key & PerftMask];
+        uint64_t count = entry->count;
+
+        if ((entry->key ^ count) == key)
+            return count;
+    }
+
+    for (int i = 0; i < size; i++) {
+        applyMove(board, moves[i], undo);
+        found += perft_recurse(board, depth-1);
+        revertMove(board, moves[i], undo);
+    }
+
+    if (PerftHashing && depth >= PERFT_HASH_DEPTH) {
+        PerftEntry *entry = &PerftTable[key & PerftMask];
+        entry->key = key ^ found, entry->count = found;
+    }
+
+    return found;
+}
+
+static void *perft_worker(void *cargo) {
+
+    // Claim the next root move until none are left
+
+    PerftJob *job = (PerftJob*) cargo;
+    Undo undo[1];
+
+    for (int i = atomic_fetch_add(job->next, 1); i < job->size; i = atomic_fetch_add(job->next, 1)) {
+        applyMove(&job->board, job->moves[i], undo);
+        job->counts[i] = job->depth > 1 ? perft_recurse(&job->board, job->depth-1) : 1;
+        revertMove(&job->board, job->moves[i], undo);
+    }
+
+    return NULL;
+}
+
+uint64_t perft(Board *board, int depth) {
+    return depth == 0 ? 1ull : perft_recurse(board, depth);
+}
+
+uint64_t perftRoot(Board *board, int depth, int nthreads, int megabytes, uint16_t *moves, uint64_t *counts, int *size) {
+
+    /// Count each root move separately, for use by divide, with nthreads each
+    /// searching their own copy of the board. Entries remain valid for any
+    /// position, so the table is kept between calls until its size changes
+
+    uint64_t total = 0ull;
+    atomic_int next = 0;
+
+    nthreads = nthreads < 1 ? 1 : nthreads;
+    *size = genAllLegalMoves(board, moves);
+
+    if (depth == 0) return 1ull;
+
+    // Round down to a power of two number of Entries
+    if ((PerftHashing = megabytes > 0) && megabytes != PerftTableMB) {
+
+        uint64_t entries = 1;
+        while (2 * entries * sizeof(PerftEntry) <= (uint64_t) megabytes << 20)
+            entries *= 2;
+
+        free(PerftTable);
+        PerftTable   = calloc(entries, sizeof(PerftEntry));
+        PerftMask    = entries - 1;
+        PerftTableMB = megabytes;
+    }
+
+    PerftJob *jobs = malloc(sizeof(PerftJob) * nthreads);
+    pthread_t *pthreads = malloc(sizeof(pthread_t) * nthreads);
+
+    for (int i = 0; i < nthreads; i++) {
+        jobs[i] = (PerftJob) { *board, depth, *size, moves, counts, &next };
+        jobs[i].board.thread = NULL; // No NNUE updates are needed
+    }
+
+    for (int i = 1; i < nthreads; i++)
+        pthread_create(&pthreads[i], NULL, perft_worker, &jobs[i]);
+
+    perft_worker(&jobs[0]);
+
+    for (int i = 1; i < nthreads; i++)
+        pthread_join(pthreads[i], NULL);
+
+    for (int i = 0; i < *size; i++)
+        total += counts[i];
+
+    free(jobs); free(pthreads);
+
+    return total;
+}
@@ -0,0 +1,40 @@
+/*
+  Ethereal is a UCI chess playing engine authored by Andrew Grant.
+  <https://github.com/AndyGrant/Ethereal>     <andrew@grantnet.us>
+
+  Ethereal is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Ethereal is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "types.h"
+
+/// Perft counts the leaves of the legal move tree, and is used to verify move
+/// generation as well as to measure its speed. Since only legal moves are ever
+/// generated, the final ply is counted in bulk without making the moves. An
+/// optional table of PerftHash megabytes stores counts of interior positions,
+/// keyed by their hash and depth. Threads split the moves of the root between
+/// them, and share the table using lockless entries, which XOR the key with
+/// the count so that a torn write is never mistaken for a hit
+
+enum { PERFT_HASH_DEPTH = 2 };
+
+struct PerftEntry {
+    uint64_t key, count;
+};
+
+uint64_t perft(Board *board, int depth);
+uint64_t perftRoot(Board *board, int depth, int nthreads, int megabytes, uint16_t *moves, uint64_t *counts, int *size);
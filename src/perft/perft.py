@@ -23,7 +23,7 @@ import argparse, subprocess, sys, time
 parser = argparse.ArgumentParser()
 parser.add_argument('engine',  help='Path to Engine')
 parser.add_argument('dataset', help='PERFT data file')
-parser.add_argument('--depth', help='Depth of PERFT [ blank = unlimited ]', default=128)
+parser.add_argument('--depth', help='Depth of PERFT [ blank = unlimited ]', default=128, type=int)
 arguments = parser.parse_args()
 
 process = subprocess.Popen(
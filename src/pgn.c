@@ -347,7 +347,7 @@ static void pgn_read_moves(FILE *pgn, FILE *bindata, PGNData *data, HalfKPSample
 
         // Use the sample if it is quiet and within [-2000, 2000] cp
         if (    abs(eval) <= 2000
-            && !board->kingAttackers
+            && !boardKingAttackers(board)
             && !moveIsTactical(board, move)
             && (board->turn == WHITE ? data->is_white : data->is_black))
             build_halfkp_sample(board, &samples[placed++], data->result, eval);
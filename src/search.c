@@ -21,6 +21,7 @@
 #include <math.h>
 #include <pthread.h>
 #include <setjmp.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +34,7 @@
 #include "evaluate.h"
 #include "pyrrhic/tbprobe.h"
 #include "history.h"
+#include "mate.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepicker.h"
@@ -48,10 +50,106 @@
 int LMRTable[64][64];
 int LateMovePruningCounts[2][11];
 
-volatile int ABORT_SIGNAL; // Global ABORT flag for threads
-volatile int IS_PONDERING; // Global PONDER flag for threads
+atomic_int ABORT_SIGNAL;    // Global ABORT flag for threads
+atomic_int IS_PONDERING;    // Global PONDER flag for threads
 volatile int ANALYSISMODE; // Whether to make some changes for Analysis
 
+static pthread_mutex_t PonderLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  PonderCond = PTHREAD_COND_INITIALIZER;
+
+int HelperSkipDepths;   // Helpers skip some depths, set by UCI option HelperSkipDepths
+int HelperWindowOffset; // Helpers shift their aspiration windows, by HelperWindowOffset
+int HelperMoveNoise;    // Helpers perturb quiet move ordering, by up to HelperMoveNoise
+int MultiPVSplit;       // Threads share out the root moves, set by UCI option MultiPVSplit
+
+static pthread_mutex_t SyncLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  SyncCond = PTHREAD_COND_INITIALIZER;
+static int SyncArrived, SyncExited, SyncRound; // Helpers of deterministic searches
+
+void signalPonderhit() {
+
+    // Pondering ends, so wake anyone waiting to report a bestmove
+    pthread_mutex_lock(&PonderLock);
+    IS_PONDERING = 0;
+    pthread_cond_broadcast(&PonderCond);
+    pthread_mutex_unlock(&PonderLock);
+}
+
+void signalStop() {
+
+    // Threads poll the flag at every node, so they stop almost at once
+    ABORT_SIGNAL = 1;
+    signalPonderhit();
+}
+
+static void wait_for_ponderhit() {
+
+    // Sleep, rather than spin, until a ponderhit or stop arrives
+    pthread_mutex_lock(&PonderLock);
+    while (IS_PONDERING)
+        pthread_cond_wait(&PonderCond, &PonderLock);
+    pthread_mutex_unlock(&PonderLock);
+}
+
+static bool sync_iteration(Thread *thread) {
+
+    /// Deterministic searches keep every Thread on the same iteration. Helpers
+    /// wait here after each iteration. The main thread waits for all of them,
+    /// moves their pending stores into the TT, and decides whether to go on.
+    /// The main thread releases the helpers once it starts the next depth
+
+    pthread_mutex_lock(&SyncLock);
+
+    if (thread->index) {
+
+        const int round = SyncRound;
+
+        SyncArrived++;
+        pthread_cond_broadcast(&SyncCond);
+
+        while (round == SyncRound && !ABORT_SIGNAL)
+            pthread_cond_wait(&SyncCond, &SyncLock);
+    }
+
+    else while (SyncArrived + SyncExited < thread->nthreads - 1)
+        pthread_cond_wait(&SyncCond, &SyncLock);
+
+    pthread_mutex_unlock(&SyncLock);
+
+    if (!thread->index) tt_pending_flush(thread->threads);
+    return !ABORT_SIGNAL;
+}
+
+static void sync_release(bool exiting) {
+
+    // Start the next round of a deterministic search, or note a helper leaving
+    pthread_mutex_lock(&SyncLock);
+    if (exiting) SyncExited++;
+    else SyncArrived = 0, SyncRound++;
+    pthread_cond_broadcast(&SyncCond);
+    pthread_mutex_unlock(&SyncLock);
+}
+
+static bool helper_skips_depth(Thread *thread) {
+
+    /// Lazy SMP helpers which all walk the same sequence of depths differ only
+    /// through races on the TT. With HelperSkipDepths, each helper skips depths
+    /// in one of several patterns, so that some are always searching ahead. The
+    /// groups of a split MultiPV search must complete every depth to be merged
+
+    static const int SkipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+    static const int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    const int pattern = (thread->index - 1) % 20;
+
+    return  HelperSkipDepths
+        &&  thread->index != 0
+        &&  thread->pending == NULL
+        && !thread->splits
+        &&  thread->depth >  1
+        && ((thread->depth + SkipPhase[pattern]) / SkipSize[pattern]) % 2;
+}
+
 
 static void select_from_threads(Thread *threads, uint16_t *best, uint16_t *ponder, int *score) {
 
@@ -122,28 +220,157 @@ static void revert_best_line(Thread *thread) {
         thread->completed = thread->depth - 1;
 }
 
-static void report_multipv_lines(Thread *thread) {
+static void split_root_moves(Thread *threads, Board *board, Limits *limits) {
 
-    /// We've just finished a depth during a MultiPV search. Now we will
-    /// once again report the lines, but this time ordering them based on
-    /// their scores. It is possible, although generally unusual, for a
-    /// move searched later to have a better score than an earlier move.
+    /// In a split MultiPV search, the root moves are dealt out to groups of
+    /// Threads, one move at a time. Each group then searches the best lines
+    /// among its own moves, and the main thread merges the lines of all the
+    /// groups. Extra Threads beyond the number of root moves join a group
+
+    uint16_t moves[MAX_MOVES];
+    int size = genAllLegalMoves(board, moves), count = 0;
+
+    for (int i = 0; i < threads->nthreads; i++)
+        threads[i].rootCount = 0;
+
+    // Respect searchmoves and any exclusions from the Tablebases
+    for (int i = 0; i < size; i++)
+        if (moveIsInRootMoves(&threads[0], moves[i]))
+            moves[count++] = moves[i];
+
+    const int splits = MultiPVSplit && limits->multiPV > 1
+                    && threads->nthreads > 1 && threads->pending == NULL
+                     ? MAX(1, MIN(threads->nthreads, count)) : 0;
+
+    for (int i = 0; i < threads->nthreads; i++) {
+
+        threads[i].splits = splits;
+
+        for (int j = splits ? i % splits : count; j < count; j += splits)
+            threads[i].rootMoves[threads[i].rootCount++] = moves[j];
+
+        // Never search more lines than there are moves to search
+        threads[i].lines = MIN(limits->multiPV, splits ? threads[i].rootCount : count);
+
+        // Room for the lines of every depth, since groups finish depths at their own pace
+        if (splits)
+            threads[i].donePvs = realloc(threads[i].donePvs, sizeof(PVariation) * MAX_PLY * MAX(1, threads[i].lines));
+    }
+}
+
+static void save_multipv_lines(Thread *thread) {
+
+    // Publish the lines of a split MultiPV search after a full iteration
+    pthread_mutex_lock(&thread->doneLock);
+    memcpy(&thread->donePvs[thread->depth * thread->lines], thread->mpvs, sizeof(PVariation) * thread->lines);
+    thread->doneDepth = thread->depth;
+    pthread_mutex_unlock(&thread->doneLock);
+}
+
+static int split_completed_depth(Thread *thread) {
+
+    // The depth which every group of a split MultiPV search has completed
+
+    int depth = MAX_PLY;
+
+    for (int group = 0; group < thread->splits; group++) {
+
+        int deepest = 0;
+
+        for (int i = group; i < thread->nthreads; i += thread->splits)
+            deepest = MAX(deepest, thread->threads[i].doneDepth);
+
+        depth = MIN(depth, deepest);
+    }
+
+    return depth;
+}
 
-    for (int i = 0; i < thread->limits->multiPV; i++) {
+static int merge_multipv_lines(Thread *thread, int depth) {
 
-        for (int j = i + 1; j < thread->limits->multiPV; j++) {
+    /// Gather into the main thread the lines which every group of a split
+    /// MultiPV search found at the given depth, which all groups have since
+    /// completed. Lines from different depths are never mixed, as neither
+    /// their scores nor their orderings would be comparable
 
-            if (thread->mpvs[j].score > thread->mpvs[i].score) {
+    Thread *const threads = thread->threads;
+    int count = 0;
+
+    for (int group = 0; depth > 0 && group < thread->splits; group++) {
+
+        // Some Thread of the group has completed the depth
+        int index = group;
+        while (threads[index].doneDepth < depth)
+            index += thread->splits;
+
+        Thread *const owner = &threads[index];
+
+        pthread_mutex_lock(&owner->doneLock);
+        memcpy(&thread->mpvs[count], &owner->donePvs[depth * owner->lines], sizeof(PVariation) * owner->lines);
+        count += owner->lines;
+        pthread_mutex_unlock(&owner->doneLock);
+    }
+
+    return count;
+}
+
+static void sort_lines(PVariation *pvs, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        for (int j = i + 1; j < count; j++) {
+
+            if (pvs[j].score > pvs[i].score) {
                 PVariation localpv;
-                memcpy(&localpv,         &thread->mpvs[i], sizeof(PVariation));
-                memcpy(&thread->mpvs[i], &thread->mpvs[j], sizeof(PVariation));
-                memcpy(&thread->mpvs[j], &localpv        , sizeof(PVariation));
+                memcpy(&localpv, &pvs[i] , sizeof(PVariation));
+                memcpy(&pvs[i] , &pvs[j] , sizeof(PVariation));
+                memcpy(&pvs[j] , &localpv, sizeof(PVariation));
             }
         }
     }
+}
 
-    for (thread->multiPV = 0; thread->multiPV < thread->limits->multiPV; thread->multiPV++)
+static int sort_multipv_lines(Thread *thread) {
+
+    /// We've just finished a depth during a MultiPV search. Now we will
+    /// once again gather the lines, but this time ordering them based on
+    /// their scores. It is possible, although generally unusual, for a
+    /// move searched later to have a better score than an earlier move.
+
+    if (!thread->splits) {
+        sort_lines(thread->mpvs, thread->lines);
+        return thread->lines;
+    }
+
+    // Keep the best merged line of each depth which every group has since
+    // completed, which time management uses as it would the main thread's
+    for (int target = split_completed_depth(thread); thread->splitCompleted < target; ) {
+        const int depth = ++thread->splitCompleted;
+        sort_lines(thread->mpvs, merge_multipv_lines(thread, depth));
+        memcpy(&thread->splitPvs[depth], &thread->mpvs[0], sizeof(PVariation));
+    }
+
+    const int count = merge_multipv_lines(thread, thread->splitCompleted);
+    sort_lines(thread->mpvs, count);
+    return count;
+}
+
+static void report_multipv_lines(Thread *thread) {
+
+    const int count = sort_multipv_lines(thread);
+    const int depth = thread->depth;
+
+    // Split searches only report once every group completes another depth,
+    // and they report that depth instead of the depth of the main thread
+    if (thread->splits) {
+        if (thread->splitCompleted == thread->doneReported) return;
+        thread->doneReported = thread->depth = thread->splitCompleted;
+    }
+
+    for (thread->multiPV = 0; thread->multiPV < MIN(count, thread->limits->multiPV); thread->multiPV++)
         uciReport(thread->threads, &thread->mpvs[thread->multiPV], -MATE, MATE);
+
+    thread->depth = depth;
 }
 
 
@@ -171,11 +398,13 @@ void *start_search_threads(void *arguments) {
     char str[6];
     uint16_t best = NONE_MOVE, ponder = NONE_MOVE;
 
-    // Execute search, setting best and ponder moves
-    getBestMove(threads, board, limits, &best, &ponder, &score);
+    // Execute search, setting best and ponder moves. Searches for
+    // a forced mate use a proof-number search instead of alpha-beta
+    if (limits->limitedByMate) mateSearch(threads, board, limits, &best, &ponder, &score);
+    else getBestMove(threads, board, limits, &best, &ponder, &score);
 
     // UCI spec does not want reports until out of pondering
-    while (IS_PONDERING);
+    wait_for_ponderhit();
 
     // Report best move ( we should always have one )
     moveToString(best, str, board->chess960);
@@ -195,7 +424,6 @@ void *start_search_threads(void *arguments) {
 
 void getBestMove(Thread *threads, Board *board, Limits *limits, uint16_t *best, uint16_t *ponder, int *score) {
 
-    pthread_t pthreads[threads->nthreads];
     TimeManager tm = {0}; tm_init(limits, &tm);
 
     // Minor house keeping for starting a search
@@ -207,18 +435,40 @@ void getBestMove(Thread *threads, Board *board, Limits *limits, uint16_t *best,
     if (!limits->limitedByMoves && limits->multiPV == 1)
         tablebasesProbeDTZ(board, limits);
 
-    // Create a new thread for each of the helpers and reuse the current
+    // Decide on the lines to search, and deal out root moves if splitting
+    split_root_moves(threads, board, limits);
+
+    // No helper of a deterministic search has yet finished an iteration
+    SyncArrived = SyncExited = 0;
+
+    // Wake the parked Worker of each of the helpers and reuse the current
     // thread for the main thread, which avoids some overhead and saves
     // us from having the current thread eating CPU time while waiting
     for (int i = 1; i < threads->nthreads; i++)
-        pthread_create(&pthreads[i], NULL, &iterativeDeepening, &threads[i]);
+        startWorker(&threads[i].worker, &iterativeDeepening, &threads[i]);
     iterativeDeepening((void*) &threads[0]);
 
     // When the main thread exits it should signal for the helpers to
-    // shutdown. Wait until all helpers have finished before moving on
+    // shutdown. Wait until all helpers have parked before moving on
     ABORT_SIGNAL = 1;
+    if (threads->pending != NULL) sync_release(false);
     for (int i = 1; i < threads->nthreads; i++)
-        pthread_join(pthreads[i], NULL);
+        waitWorker(&threads[i].worker);
+
+    // Deterministic searches keep the stores of any unfinished iteration
+    if (threads->pending != NULL) tt_pending_flush(threads);
+
+    // Gather the final lines, reporting any depth the main thread has yet to
+    if (threads->splits)
+        report_multipv_lines(threads);
+
+    // Split MultiPV searches take the best of the merged lines instead
+    if (threads->splits && threads->splitCompleted) {
+        *best   = threads->mpvs[0].line[0];
+        *ponder = threads->mpvs[0].length > 1 ? threads->mpvs[0].line[1] : NONE_MOVE;
+        *score  = threads->mpvs[0].score;
+        return;
+    }
 
     // Pick the best of our completed threads
     select_from_threads(threads, best, ponder, score);
@@ -235,6 +485,9 @@ void* iterativeDeepening(void *vthread) {
     if (thread->nthreads > 8)
         bindThisThread(thread->index);
 
+    // Select the slice of the TT for NUMA builds with local placement
+    tt_numa_attach(thread->index, thread->nthreads);
+
     // Perform iterative deepening until exit conditions
     for (thread->depth = 1; thread->depth < MAX_PLY; thread->depth++) {
 
@@ -245,29 +498,58 @@ void* iterativeDeepening(void *vthread) {
         if (setjmp(thread->jbuffer)) break;
         #endif
 
+        // Let the helpers of a deterministic search begin the next depth
+        if (mainThread && thread->pending != NULL && thread->depth > 1)
+            sync_release(false);
+
+        // Some helpers move straight on to a later depth
+        if (helper_skips_depth(thread)) continue;
+
         // Perform a search for the current depth for each requested line of play
-        for (thread->multiPV = 0; thread->multiPV < limits->multiPV; thread->multiPV++)
+        for (thread->multiPV = 0; thread->multiPV < thread->lines; thread->multiPV++)
             aspirationWindow(thread);
 
+        // Split MultiPV searches end once every group reaches the depth limit
+        if (thread->splits) {
+            save_multipv_lines(thread);
+            if (   limits->limitedByDepth && !IS_PONDERING
+                && split_completed_depth(thread) >= limits->depthLimit)
+                ABORT_SIGNAL = 1;
+        }
+
+        // Deterministic searches wait for every Thread to finish the depth
+        if (thread->pending != NULL && !sync_iteration(thread)) break;
+
         // Helper threads need not worry about time and search info updates
         if (!mainThread) continue;
 
         // We delay reporting during MultiPV searches
         if (limits->multiPV > 1) report_multipv_lines(thread);
 
+        // Split MultiPV searches manage time with the merged lines of all groups
+        const PVariation *pvs = thread->splits ? thread->splitPvs : thread->pvs;
+        const int completed   = thread->splits ? thread->splitCompleted : thread->completed;
+        const uint64_t nodes  = thread->splits ? nodesSearchedThreadPool(thread->threads) : thread->nodes;
+
         // Update clock based on score and pv changes
-        tm_update(thread, limits, tm);
+        tm_update(pvs, completed, limits, tm);
 
         // Don't want to exit while pondering
         if (IS_PONDERING) continue;
 
         // Check for termination by any of the possible limits
-        if (   (limits->limitedBySelf  && tm_finished(thread, tm))
-            || (limits->limitedByDepth && thread->depth >= limits->depthLimit)
+        if (   (limits->limitedBySelf  && tm_finished(pvs, completed, nodes, tm))
+            || (limits->limitedByDepth && thread->depth >= limits->depthLimit && !thread->splits)
+            || (thread->splits && ABORT_SIGNAL)
+            || (limits->limitedByMate  && pvs[completed].score >= MATE - 2 * limits->mateLimit + 1)
             || (limits->limitedByTime  && elapsed_time(tm) >= limits->timeLimit))
             break;
     }
 
+    // Helpers of a deterministic search are no longer waited upon
+    if (!mainThread && thread->pending != NULL)
+        sync_release(true);
+
     return NULL;
 }
 
@@ -278,10 +560,13 @@ void aspirationWindow(Thread *thread) {
     int alpha  = -MATE, beta = MATE, delta = WindowSize;
     int report = !thread->index && thread->limits->multiPV == 1;
 
+    // Helpers may centre their window above or below the previous score
+    int offset = !thread->index ? 0 : thread->index % 2 ? HelperWindowOffset : -HelperWindowOffset;
+
     // After a few depths use a previous result to form the window
     if (thread->depth >= WindowDepth) {
-        alpha = MAX(-MATE, thread->pvs[thread->completed].score - delta);
-        beta  = MIN( MATE, thread->pvs[thread->completed].score + delta);
+        alpha = MAX(-MATE, thread->pvs[thread->completed].score + offset - delta);
+        beta  = MIN( MATE, thread->pvs[thread->completed].score + offset + delta);
     }
 
     while (1) {
@@ -341,7 +626,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
     // Step 1. Quiescence Search. Perform a search using mostly tactical
     // moves to reach a more stable position for use as a static evaluation
-    if (depth <= 0 && !board->kingAttackers)
+    if (depth <= 0 && !boardKingAttackers(board))
         return qsearch(thread, pv, alpha, beta);
 
     // Ensure a fresh PV
@@ -353,11 +638,12 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
     // Updates for UCI reporting
     thread->seldepth = RootNode ? 0 : MAX(thread->seldepth, thread->height);
     thread->nodes++;
+    SEARCH_STAT(thread, nodes);
 
     // Step 2. Abort Check. Exit the search if signaled by main thread or the
     // UCI thread, or if the search time has expired outside pondering mode
-    if (   (ABORT_SIGNAL && thread->depth > 1)
-        || (tm_stop_early(thread) && !IS_PONDERING))
+    if (   (atomic_load_explicit(&ABORT_SIGNAL, memory_order_relaxed) && thread->depth > 1)
+        || (tm_stop_early(thread) && !atomic_load_explicit(&IS_PONDERING, memory_order_relaxed)))
         longjmp(thread->jbuffer, 1);
 
     // Step 3. Check for early exit conditions. Don't take early exits in
@@ -370,7 +656,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
         // Check to see if we have exceeded the maxiumum search draft
         if (thread->height >= MAX_PLY)
-            return board->kingAttackers ? 0 : evaluateBoard(thread, board);
+            return boardKingAttackers(board) ? 0 : evaluateBoard(thread, board);
 
         // Mate Distance Pruning. Check to see if this line is so
         // good, or so bad, that being mated in the ply, or  mating in
@@ -385,7 +671,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         goto search_init_goto;
 
     // Step 4. Probe the Transposition Table, adjust the value, and consider cutoffs
-    if ((ttHit = tt_probe(board->hash, thread->height, &ttMove, &ttValue, &ttEval, &ttDepth, &ttBound))) {
+    if ((ttHit = tt_probe(thread, board->hash, &ttMove, &ttValue, &ttEval, &ttDepth, &ttBound))) {
 
         // Only cut with a greater depth search, and do not return
         // when in a PvNode, unless we would otherwise hit a qsearch
@@ -397,7 +683,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
             if (    ttBound == BOUND_EXACT
                 || (ttBound == BOUND_LOWER && ttValue >= beta)
                 || (ttBound == BOUND_UPPER && ttValue <= alpha))
-                return ttValue;
+                return SEARCH_STAT(thread, ttCutoffs), ttValue;
         }
 
         // An entry coming from one depth lower than we would accept for a cutoff will
@@ -407,7 +693,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
             && (ttBound & BOUND_UPPER)
             && (cutnode || ttValue <= alpha)
             &&  ttValue + TTResearchMargin <= alpha)
-            return alpha;
+            return SEARCH_STAT(thread, ttCutoffs), alpha;
     }
 
     // Step 5. Probe the Syzygy Tablebases. tablebasesProbeWDL() handles all of
@@ -433,8 +719,8 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
             || (tbBound == BOUND_LOWER && value >= beta)
             || (tbBound == BOUND_UPPER && value <= alpha)) {
 
-            tt_store(board->hash, thread->height, NONE_MOVE, value, VALUE_NONE, depth, tbBound);
-            return value;
+            tt_store(thread, board->hash, NONE_MOVE, value, VALUE_NONE, depth, tbBound);
+            return SEARCH_STAT(thread, tbCutoffs), value;
         }
 
         // Never score something worse than the known Syzygy value
@@ -450,7 +736,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
     search_init_goto:
 
     // We can grab in check based on the already computed king attackers bitboard
-    inCheck = !!board->kingAttackers;
+    inCheck = !!boardKingAttackers(board);
 
     // Save a history of the static evaluations when not checked
     eval = ns->eval = inCheck ? VALUE_NONE
@@ -475,7 +761,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
     // Toss the static evaluation into the TT if we won't overwrite something
     if (!ttHit && !inCheck && !ns->excluded)
-        tt_store(board->hash, thread->height, NONE_MOVE, VALUE_NONE, eval, 0, BOUND_NONE);
+        tt_store(thread, board->hash, NONE_MOVE, VALUE_NONE, eval, 0, BOUND_NONE);
 
     // ------------------------------------------------------------------------
     // All elo estimates as of Ethereal 11.80, @ 12s+0.12 @ 1.275mnps
@@ -489,7 +775,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         && !ns->excluded
         &&  depth <= BetaPruningDepth
         &&  eval - BetaMargin * MAX(0, (depth - improving)) >= beta)
-        return eval;
+        return SEARCH_STAT(thread, betaPrunes), eval;
 
     // Step 8 (~3 elo). Alpha Pruning for main search loop. The idea is
     // that for low depths if eval is so bad that even a large static
@@ -499,7 +785,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         && !ns->excluded
         &&  depth <= AlphaPruningDepth
         &&  eval + AlphaMargin <= alpha)
-        return eval;
+        return SEARCH_STAT(thread, alphaPrunes), eval;
 
     // Step 9 (~93 elo). Null Move Pruning. If our position is so strong
     // that giving our opponent a double move still allows us to maintain
@@ -516,6 +802,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
         // Dynamic R based on Depth, Eval, and Tactical state
         R = 4 + depth / 5 + MIN(3, (eval - beta) / 191) + (ns-1)->tactical;
+        SEARCH_STAT(thread, nullTries);
 
         apply(thread, board, NULL_MOVE);
         value = -search(thread, &lpv, -beta, -beta+1, depth-R, !cutnode);
@@ -523,7 +810,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
         // Don't return unproven TB-Wins or Mates
         if (value >= beta)
-            return (value > TBWIN_IN_MAX) ? beta : value;
+            return SEARCH_STAT(thread, nullCutoffs), (value > TBWIN_IN_MAX) ? beta : value;
     }
 
     // Step 10 (~9 elo). Probcut Pruning. If we have a good capture that causes a
@@ -537,6 +824,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         && (!ttHit || ttValue >= rBeta || ttDepth < depth - 3)) {
 
         // Try tactical moves which maintain rBeta.
+        SEARCH_STAT(thread, probcutTries);
         init_noisy_picker(&ns->mp, thread, ttMove, rBeta - eval);
         while ((move = select_next(&ns->mp, thread, 1)) != NONE_MOVE) {
 
@@ -556,10 +844,10 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
                 // Store an entry if we don't have a better one already
                 if (value >= rBeta && (!ttHit || ttDepth < depth - 3))
-                    tt_store(board->hash, thread->height, move, value, eval, depth-3, BOUND_LOWER);
+                    tt_store(thread, board->hash, move, value, eval, depth-3, BOUND_LOWER);
 
                 // Probcut failed high verifying the cutoff
-                if (value >= rBeta) return value;
+                if (value >= rBeta) return SEARCH_STAT(thread, probcutCutoffs), value;
             }
         }
     }
@@ -570,7 +858,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
     if (    depth >= 7
         && (PvNode || cutnode)
         && (ttMove == NONE_MOVE || ttDepth + 4 < depth))
-        depth -= 1;
+        depth -= 1, SEARCH_STAT(thread, iirReductions);
 
     // Step 12. Initialize the Move Picker and being searching through each
     // move one at a time, until we run out or a move generates a cutoff. We
@@ -586,6 +874,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
         // Track Moves Seen for Late Move Pruning
         movesSeen += 1;
+        SEARCH_STAT(thread, moves);
         isQuiet = !moveIsTactical(board, move);
 
         // All moves have one or more History scores
@@ -595,10 +884,11 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         // Step 13 (~80 elo). Late Move Pruning / Move Count Pruning. If we
         // have seen many moves in this position already, and we don't expect
         // anything from this move, we can skip all the remaining quiets
-        if (   best > -TBWIN_IN_MAX
-            && depth <= LateMovePruningDepth
-            && movesSeen >= LateMovePruningCounts[improving][depth])
-            skipQuiets = 1;
+        if (   !skipQuiets
+            &&  best > -TBWIN_IN_MAX
+            &&  depth <= LateMovePruningDepth
+            &&  movesSeen >= LateMovePruningCounts[improving][depth])
+            skipQuiets = 1, SEARCH_STAT(thread, lmpSkips);
 
         // Step 14 (~175 elo). Quiet Move Pruning. Prune any quiet move that meets one
         // of the criteria below, only after proving a non mated line exists
@@ -611,25 +901,29 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
             // Step 14A (~3 elo). Futility Pruning. If our score is far below alpha,
             // and we don't expect anything from this move, we can skip all other quiets
             if (   !inCheck
+                && !skipQuiets
                 &&  eval + fmpMargin <= alpha
                 &&  lmrDepth <= FutilityPruningDepth
                 &&  hist < FutilityPruningHistoryLimit[improving])
-                skipQuiets = 1;
+                skipQuiets = 1, SEARCH_STAT(thread, futilitySkips);
 
             // Step 14B (~2.5 elo). Futility Pruning. If our score is not only far
             // below alpha but still far below alpha after adding the Futility Margin,
             // we can somewhat safely skip all quiet moves after this one
             if (   !inCheck
+                && !skipQuiets
                 &&  lmrDepth <= FutilityPruningDepth
                 &&  eval + fmpMargin + FutilityMarginNoHistory <= alpha)
-                skipQuiets = 1;
+                skipQuiets = 1, SEARCH_STAT(thread, futilityMarginSkips);
 
             // Step 14C (~10 elo). Continuation Pruning. Moves with poor counter
             // or follow-up move history are pruned near the leaf nodes of the search
             if (   ns->mp.stage > STAGE_COUNTER_MOVE
                 && lmrDepth <= ContinuationPruningDepth[improving]
-                && MIN(cmhist, fmhist) < ContinuationPruningHistoryLimit[improving])
+                && MIN(cmhist, fmhist) < ContinuationPruningHistoryLimit[improving]) {
+                SEARCH_STAT(thread, continuationPrunes);
                 continue;
+            }
         }
 
         // Step 15 (~42 elo). Static Exchange Evaluation Pruning. Prune moves which fail
@@ -638,8 +932,10 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         if (    best > -TBWIN_IN_MAX
             &&  depth <= SEEPruningDepth
             &&  ns->mp.stage > STAGE_GOOD_NOISY
-            && !staticExchangeEvaluation(board, move, seeMargin[isQuiet] - hist / 128))
+            && !staticExchangeEvaluation(board, move, seeMargin[isQuiet] - hist / 128)) {
+            SEARCH_STAT(thread, seePrunes);
             continue;
+        }
 
         // Apply move, skip if move is illegal
         if (!apply(thread, board, move))
@@ -670,12 +966,16 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         newDepth = depth + (!RootNode ? extension : 0);
         if (extension > 1) ns->dextensions++;
 
+        if (singular) SEARCH_STAT(thread, singularTries);
+        if (singular && extension > 0) SEARCH_STAT(thread, singularExtensions);
+        if (extension > 1) SEARCH_STAT(thread, doubleExtensions);
+
         // Step 17. MultiCut. Sometimes candidate Singular moves are shown to be non-Singular.
         // If this happens, and the rBeta used is greater than beta, then we have multiple moves
         // which appear to beat beta at a reduced depth. singularity() sets the stage to STAGE_DONE
 
         if (ns->mp.stage == STAGE_DONE)
-            return MAX(ttValue - depth, -MATE);
+            return SEARCH_STAT(thread, multiCuts), MAX(ttValue - depth, -MATE);
 
         if (depth > 2 && played > 1) {
 
@@ -710,7 +1010,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
                 R = 3 - (hist / 4952);
 
                 // Reduce for moves that give check
-                R -= !!board->kingAttackers;
+                R -= !!boardKingAttackers(board);
             }
 
             // Don't extend or drop into QS
@@ -718,6 +1018,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
             // Perform reduced depth search on a Null Window
             value = -search(thread, &lpv, -alpha-1, -alpha, newDepth-R, true);
+            SEARCH_STAT(thread, lmrSearches);
 
             if (value > alpha && R > 1) {
 
@@ -725,9 +1026,12 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 
                 newDepth += value > best + 35;
                 newDepth -= value < best + newDepth;
+                SEARCH_STAT(thread, lmrFailHighs);
 
-                if (newDepth - 1 > lmrDepth)
+                if (newDepth - 1 > lmrDepth) {
                     value = -search(thread, &lpv, -alpha-1, -alpha, newDepth-1, !cutnode);
+                    SEARCH_STAT(thread, lmrResearches);
+                }
 
                 doFullSearch = false;
             }
@@ -739,12 +1043,16 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         else doFullSearch = !PvNode || played > 1;
 
         // Full depth search on a null window
-        if (doFullSearch)
+        if (doFullSearch) {
             value = -search(thread, &lpv, -alpha-1, -alpha, newDepth-1, !cutnode);
+            SEARCH_STAT(thread, fullSearches);
+        }
 
         // Full depth search on a full window for some PvNodes
-        if (PvNode && (played == 1 || value > alpha))
+        if (PvNode && (played == 1 || value > alpha)) {
             value = -search(thread, &lpv, -beta, -alpha, newDepth-1, FALSE);
+            SEARCH_STAT(thread, pvSearches);
+        }
 
         // Revert the board state
         revert(thread, board, move);
@@ -752,9 +1060,9 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         // Reset the extension tracker
         if (extension > 1) ns->dextensions--;
 
-        // Track where nodes were spent in the Main thread at the Root
-        if (RootNode && !thread->index)
-            thread->tm->nodes[move] += thread->nodes - starting_nodes;
+        // Track where nodes were spent at the Root, by every Thread when splitting
+        if (RootNode && (!thread->index || thread->splits))
+            __atomic_fetch_add(&thread->tm->nodes[move], thread->nodes - starting_nodes, __ATOMIC_RELAXED);
 
         // Step 19. Update search stats for the best move and its value. Update
         // our lower bound (alpha) if exceeded, and also update the PV in that case
@@ -772,7 +1080,11 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
                 memcpy(pv->line + 1, lpv.line, sizeof(uint16_t) * lpv.length);
 
                 // Search failed high
-                if (alpha >= beta) break;
+                if (alpha >= beta) {
+                    SEARCH_STAT(thread, failHighs);
+                    if (played == 1) SEARCH_STAT(thread, firstMoveFailHighs);
+                    break;
+                }
             }
         }
     }
@@ -803,7 +1115,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
         ttBound  = best >= beta    ? BOUND_LOWER
                  : best > oldAlpha ? BOUND_EXACT : BOUND_UPPER;
         bestMove = ttBound == BOUND_UPPER ? NONE_MOVE : bestMove;
-        tt_store(board->hash, thread->height, bestMove, best, eval, depth, ttBound);
+        tt_store(thread, board->hash, bestMove, best, eval, depth, ttBound);
     }
 
     return best;
@@ -825,11 +1137,12 @@ int qsearch(Thread *thread, PVariation *pv, int alpha, int beta) {
     // Updates for UCI reporting
     thread->seldepth = MAX(thread->seldepth, thread->height);
     thread->nodes++;
+    SEARCH_STAT(thread, qnodes);
 
     // Step 1. Abort Check. Exit the search if signaled by main thread or the
     // UCI thread, or if the search time has expired outside pondering mode
-    if (   (ABORT_SIGNAL && thread->depth > 1)
-        || (tm_stop_early(thread) && !IS_PONDERING))
+    if (   (atomic_load_explicit(&ABORT_SIGNAL, memory_order_relaxed) && thread->depth > 1)
+        || (tm_stop_early(thread) && !atomic_load_explicit(&IS_PONDERING, memory_order_relaxed)))
         longjmp(thread->jbuffer, 1);
 
     // Step 2. Draw Detection. Check for the fifty move rule, repetition, or insufficient
@@ -842,13 +1155,13 @@ int qsearch(Thread *thread, PVariation *pv, int alpha, int beta) {
         return evaluateBoard(thread, board);
 
     // Step 4. Probe the Transposition Table, adjust the value, and consider cutoffs
-    if ((ttHit = tt_probe(board->hash, thread->height, &ttMove, &ttValue, &ttEval, &ttDepth, &ttBound))) {
+    if ((ttHit = tt_probe(thread, board->hash, &ttMove, &ttValue, &ttEval, &ttDepth, &ttBound))) {
 
         // Table is exact or produces a cutoff
         if (    ttBound == BOUND_EXACT
             || (ttBound == BOUND_LOWER && ttValue >= beta)
             || (ttBound == BOUND_UPPER && ttValue <= alpha))
-            return ttValue;
+            return SEARCH_STAT(thread, qttCutoffs), ttValue;
     }
 
     // Save a history of the static evaluations
@@ -856,21 +1169,21 @@ int qsearch(Thread *thread, PVariation *pv, int alpha, int beta) {
                     ? ttEval : evaluateBoard(thread, board);
 
     // Toss the static evaluation into the TT if we won't overwrite something
-    if (!ttHit && !board->kingAttackers)
-        tt_store(board->hash, thread->height, NONE_MOVE, VALUE_NONE, eval, 0, BOUND_NONE);
+    if (!ttHit && !boardKingAttackers(board))
+        tt_store(thread, board->hash, NONE_MOVE, VALUE_NONE, eval, 0, BOUND_NONE);
 
     // Step 5. Eval Pruning. If a static evaluation of the board will
     // exceed beta, then we can stop the search here. Also, if the static
     // eval exceeds alpha, we can call our static eval the new alpha
     best = eval;
     alpha = MAX(alpha, eval);
-    if (alpha >= beta) return eval;
+    if (alpha >= beta) return SEARCH_STAT(thread, standPats), eval;
 
     // Step 6. Delta Pruning. Even the best possible capture and or promotion
     // combo, with a minor boost for pawn captures, would still fail to cover
     // the distance between alpha and the evaluation. Playing a move is futile.
     if (MAX(QSDeltaMargin, moveBestCaseValue(board)) < alpha - eval)
-        return eval;
+        return SEARCH_STAT(thread, deltaPrunes), eval;
 
     // Step 7. Move Generation and Looping. Generate all tactical moves
     // and return those which are winning via SEE, and also strong enough
@@ -890,7 +1203,7 @@ int qsearch(Thread *thread, PVariation *pv, int alpha, int beta) {
             revert(thread, board, move);
             pv->length = 1;
             pv->line[0] = move;
-            return beta;
+            return SEARCH_STAT(thread, qsShortCircuits), beta;
         }
 
         value = -qsearch(thread, &lpv, -beta, -alpha);
@@ -921,7 +1234,7 @@ int qsearch(Thread *thread, PVariation *pv, int alpha, int beta) {
     // Step 8. Store results of search into the Transposition Table.
     ttBound = best >= beta    ? BOUND_LOWER
             : best > oldAlpha ? BOUND_EXACT : BOUND_UPPER;
-    tt_store(board->hash, thread->height, bestMove, best, eval, 0, ttBound);
+    tt_store(thread, board->hash, bestMove, best, eval, 0, ttBound);
 
     return best;
 }
@@ -1055,3 +1368,50 @@ int singularity(Thread *thread, uint16_t ttMove, int ttValue, int depth, int PvN
          : ttValue <= alpha ? -1 // Negative extension if ttValue was already failing-low
          : 0;                    // Not singular, and unlikely to produce a cutoff
 }
+
+void search_print_stats(Thread *threads, const char *prefix) {
+
+    /// Sum up the counters of every Thread, and report the rates of each step.
+    /// Each counter of SearchStats is a uint64_t, so they are summed as an array
+
+    SearchStats total = {0};
+    uint64_t *sums = (uint64_t*) &total;
+    const int fields = sizeof(SearchStats) / sizeof(uint64_t);
+
+    for (int i = 0; i < threads->nthreads; i++)
+        for (int j = 0; j < fields; j++)
+            sums[j] += ((uint64_t*) &threads[i].searchstats)[j];
+
+    const double nodes = MAX(1, total.nodes), moves = MAX(1, total.moves);
+    const double qnodes = MAX(1, total.qnodes), lmr = MAX(1, total.lmrSearches);
+
+    printf("%sSearch Nodes %12"PRIu64"  TT Cuts  %6.2f%%  TB Cuts   %6.2f%%  IIR        %6.2f%%\n", prefix,
+        total.nodes, 100.0 * total.ttCutoffs / nodes, 100.0 * total.tbCutoffs / nodes,
+        100.0 * total.iirReductions / nodes);
+
+    printf("%sPruning      %12s  Beta     %6.2f%%  Alpha     %6.2f%%  Null Move  %6.2f%% of %6.2f%%\n", prefix,
+        "", 100.0 * total.betaPrunes / nodes, 100.0 * total.alphaPrunes / nodes,
+        100.0 * total.nullCutoffs / MAX(1, total.nullTries), 100.0 * total.nullTries / nodes);
+
+    printf("%sProbcut      %12"PRIu64"  Cutoffs  %6.2f%%  Multicuts %6.2f%%  Fail Highs %6.2f%% First %6.2f%%\n", prefix,
+        total.probcutTries, 100.0 * total.probcutCutoffs / MAX(1, total.probcutTries),
+        100.0 * total.multiCuts / nodes, 100.0 * total.failHighs / nodes,
+        100.0 * total.firstMoveFailHighs / MAX(1, total.failHighs));
+
+    printf("%sSearch Moves %12"PRIu64"  SEE      %6.2f%%  History   %6.2f%%  Skips LMP  %6.2f%% FP %6.2f%% / %6.2f%%\n", prefix,
+        total.moves, 100.0 * total.seePrunes / moves, 100.0 * total.continuationPrunes / moves,
+        100.0 * total.lmpSkips / nodes, 100.0 * total.futilitySkips / nodes,
+        100.0 * total.futilityMarginSkips / nodes);
+
+    printf("%sSingular     %12"PRIu64"  Extended %6.2f%%  Double    %6.2f%%\n", prefix,
+        total.singularTries, 100.0 * total.singularExtensions / MAX(1, total.singularTries),
+        100.0 * total.doubleExtensions / MAX(1, total.singularTries));
+
+    printf("%sLMR Searches %12"PRIu64"  Beat     %6.2f%%  Research  %6.2f%%  Full %12"PRIu64"  PV %12"PRIu64"\n", prefix,
+        total.lmrSearches, 100.0 * total.lmrFailHighs / lmr, 100.0 * total.lmrResearches / lmr,
+        total.fullSearches, total.pvSearches);
+
+    printf("%sQS Nodes     %12"PRIu64"  TT Cuts  %6.2f%%  Stand Pat %6.2f%%  Delta      %6.2f%% Short Circuits %6.2f%%\n", prefix,
+        total.qnodes, 100.0 * total.qttCutoffs / qnodes, 100.0 * total.standPats / qnodes,
+        100.0 * total.deltaPrunes / qnodes, 100.0 * total.qsShortCircuits / qnodes);
+}
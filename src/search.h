@@ -28,7 +28,32 @@ struct PVariation {
     uint16_t line[MAX_PLY];
 };
 
+/// Builds made with STATS=1 count, for each Thread, how often the steps of the
+/// search are attempted and how often they succeed. Pruning of single moves is
+/// relative to the moves considered, while skipping quiets counts each time the
+/// remaining quiets were dropped. LMR re-searches are the reduced searches that
+/// beat alpha and were repeated at a greater depth. The quiescence counters are
+/// kept apart from those of the main search
+
+struct SearchStats {
+    uint64_t nodes, ttCutoffs, tbCutoffs, betaPrunes, alphaPrunes;
+    uint64_t nullTries, nullCutoffs, probcutTries, probcutCutoffs, iirReductions;
+    uint64_t moves, lmpSkips, futilitySkips, futilityMarginSkips, continuationPrunes, seePrunes;
+    uint64_t singularTries, singularExtensions, doubleExtensions, multiCuts;
+    uint64_t lmrSearches, lmrFailHighs, lmrResearches, fullSearches, pvSearches;
+    uint64_t failHighs, firstMoveFailHighs;
+    uint64_t qnodes, qttCutoffs, standPats, deltaPrunes, qsShortCircuits;
+};
+
+#ifdef USE_STATS
+    #define SEARCH_STAT(thread, field) ((thread)->searchstats.field++)
+#else
+    #define SEARCH_STAT(thread, field) ((void) 0)
+#endif
+
 void initSearch();
+void signalPonderhit();
+void signalStop();
 void *start_search_threads(void *arguments);
 void getBestMove(Thread *threads, Board *board, Limits *limits, uint16_t *best, uint16_t *ponder, int *score);
 void* iterativeDeepening(void *vthread);
@@ -37,6 +62,7 @@ int search(Thread *thread, PVariation *pv, int alpha, int beta, int depth, bool
 int qsearch(Thread *thread, PVariation *pv, int alpha, int beta);
 int staticExchangeEvaluation(Board *board, uint16_t move, int threshold);
 int singularity(Thread *thread, uint16_t ttMove, int ttValue, int depth, int PvNode, int alpha, int beta, bool cutnode);
+void search_print_stats(Thread *threads, const char *prefix);
 
 static const int WindowDepth   = 4;
 static const int WindowSize    = 10;
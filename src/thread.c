@@ -16,51 +16,285 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
 #include "board.h"
 #include "history.h"
 #include "search.h"
 #include "thread.h"
 #include "transposition.h"
 #include "types.h"
+#include "windows.h"
 
 #include "nnue/types.h"
 #include "nnue/accumulator.h"
 #include "nnue/utils.h"
 
-Thread* createThreadPool(int nthreads) {
+int EvalCacheMB = 0; // Size of each Thread's static evaluation cache
+int PKCacheMB   = 2; // Size of each Thread's Pawn King evaluation cache
+int ThreadHugePages; // Request Transparent Huge Pages for the Thread pool
+int DeterministicSMP; // Hold back stores to the TT until each iteration ends
 
-    Thread *threads = calloc(nthreads, sizeof(Thread));
+static uint64_t cacheEntries(int megabytes, size_t size) {
 
-    for (int i = 0; i < nthreads; i++) {
+    // Largest power of two number of entries within the megabytes
+    uint64_t entries = megabytes > 0 ? 1ull : 0ull;
+    while (entries && 2 * entries * size <= (uint64_t) megabytes << 20)
+        entries *= 2;
+
+    return entries;
+}
+
+static void *workerLoop(void *vworker) {
+
+    Worker *worker = (Worker*) vworker;
+
+    pthread_mutex_lock(&worker->mutex);
+
+    while (1) {
+
+        // Park until there is a job to do, or we are told to exit
+        while (!worker->busy && !worker->exit)
+            pthread_cond_wait(&worker->cond, &worker->mutex);
+
+        if (worker->exit) break;
+
+        pthread_mutex_unlock(&worker->mutex);
+        worker->job(worker->cargo);
+        pthread_mutex_lock(&worker->mutex);
+
+        // Signal anyone waiting on the job to finish
+        worker->busy = false;
+        pthread_cond_broadcast(&worker->cond);
+    }
+
+    pthread_mutex_unlock(&worker->mutex);
+    return NULL;
+}
+
+void createWorker(Worker *worker) {
+
+    worker->busy = worker->exit = false;
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+    pthread_create(&worker->pthread, NULL, workerLoop, worker);
+}
+
+void deleteWorker(Worker *worker) {
+
+    waitWorker(worker);
+
+    pthread_mutex_lock(&worker->mutex);
+    worker->exit = true;
+    pthread_cond_broadcast(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+
+    pthread_join(worker->pthread, NULL);
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->mutex);
+}
+
+void startWorker(Worker *worker, void *(*job)(void*), void *cargo) {
+
+    // Only one job at a time, so finish the last one first
+    waitWorker(worker);
+
+    pthread_mutex_lock(&worker->mutex);
+    worker->job = job, worker->cargo = cargo, worker->busy = true;
+    pthread_cond_broadcast(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+void waitWorker(Worker *worker) {
+
+    pthread_mutex_lock(&worker->mutex);
+    while (worker->busy)
+        pthread_cond_wait(&worker->cond, &worker->mutex);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+
+#if defined(__linux__)
+
+static size_t threadPoolBytes(int nthreads) {
+
+    // Whole pages, so that the tail of a huge page mapping can be trimmed
+    const size_t page = sysconf(_SC_PAGESIZE);
+    return (nthreads * sizeof(Thread) + page - 1) & ~(page - 1);
+}
+
+static void *mapThreadPool(size_t bytes) {
+
+    void *mapped = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapped == MAP_FAILED) {
+        printf("info string failed to allocate %zu bytes for the Thread pool\n", bytes);
+        fflush(stdout), exit(EXIT_FAILURE);
+    }
+
+    return mapped;
+}
+
+#endif
+
+static Thread* allocateThreadPool(int nthreads) {
 
-        // Offset the Node Stack to allow looking backwards
-        threads[i].states = &(threads[i].nodeStates[STACK_OFFSET]);
+    /// Fresh anonymous pages are zeroed, and are not placed on any NUMA node until
+    /// they are first written to. Unlike calloc(), which may recycle and clear old
+    /// memory from this thread, this leaves the placement to each Thread's owner
 
-        // NULL out the entire continuation history
-        for (int j = 0; j < STACK_SIZE; j++)
-            threads[i].nodeStates[j].continuations = NULL;
+#if defined(__linux__)
+    const size_t bytes = threadPoolBytes(nthreads), align = 1ull << 21;
+
+    if (!ThreadHugePages)
+        return mapThreadPool(bytes);
+
+    // Map an extra 2MB, and then trim both ends to align with the huge pages
+    char *mapped = mapThreadPool(bytes + align);
+    char *threads = (char*) (((uintptr_t) mapped + align - 1) & ~(uintptr_t) (align - 1));
+
+    if (threads > mapped) munmap(mapped, threads - mapped);
+    munmap(threads + bytes, mapped + align - threads);
+    madvise(threads, bytes, MADV_HUGEPAGE);
+    return (Thread*) threads;
+#else
+    return calloc(nthreads, sizeof(Thread));
+#endif
+}
+
+static void resetThread(Thread *thread) {
+
+    memset(&thread->ttstats, 0, sizeof(TTStats));
+    memset(&thread->searchstats, 0, sizeof(SearchStats));
+
+    if (thread->pktable != NULL)
+        memset(thread->pktable, 0, (thread->pkmask + 1) * sizeof(PKEntry));
+
+    if (thread->evcache != NULL)
+        memset(thread->evcache, 0, (thread->evcacheMask + 1) * sizeof(uint64_t));
+    thread->evcacheProbes = thread->evcacheHits = 0ull;
+
+    memset(&thread->killers, 0, sizeof(KillerTable));
+    memset(&thread->cmtable, 0, sizeof(CounterMoveTable));
+
+    memset(&thread->history, 0, sizeof(HistoryTable));
+    memset(&thread->chistory, 0, sizeof(CaptureHistoryTable));
+    memset(&thread->continuation, 0, sizeof(ContinuationTable));
+}
+
+static void *initThread(void *vthread) {
+
+    /// Runs on the pthread which will search with this Thread, so that all of its
+    /// state is allocated and first touched from the CPU, and thus the NUMA node,
+    /// that it will be bound to during the search. The main Thread is initialized
+    /// from a short lived pthread, which binds itself in the same way
+
+    Thread *const thread = (Thread*) vthread;
+
+    const uint64_t entries   = cacheEntries(EvalCacheMB, sizeof(uint64_t));
+    const uint64_t pkentries = cacheEntries(PKCacheMB, sizeof(PKEntry));
+
+    // Bind when we expect to deal with NUMA
+    if (thread->nthreads > 8)
+        bindThisThread(thread->index);
+
+    // Touch the search stacks now, rather than from whoever next uses them
+    memset(&thread->board, 0, sizeof(Board));
+    memset(thread->pvs, 0, sizeof(thread->pvs));
+    memset(thread->mpvs, 0, sizeof(thread->mpvs));
+    memset(thread->undoStack, 0, sizeof(thread->undoStack));
+    memset(thread->nodeStates, 0, sizeof(thread->nodeStates));
+
+    // Offset the Node Stack to allow looking backwards
+    thread->states = &(thread->nodeStates[STACK_OFFSET]);
+
+    // NULL out the entire continuation history
+    for (int j = 0; j < STACK_SIZE; j++)
+        thread->nodeStates[j].continuations = NULL;
+
+    // Accumulator stack and table require alignment
+    thread->nnue = nnue_create_evaluator();
+
+    // Static evaluation cache, which may be disabled entirely
+    thread->evcache     = entries ? calloc(entries, sizeof(uint64_t)) : NULL;
+    thread->evcacheMask = entries - 1;
+
+    // Pawn King evaluation cache, which NNUE builds may go without
+    thread->pktable = pkentries ? calloc(pkentries, sizeof(PKEntry)) : NULL;
+    thread->pkmask  = pkentries - 1;
+
+    // Near Transposition Table, only when NearHashDepth is set
+    thread->nearBuckets = tt_near_create();
+
+    // Pending stores, only for deterministic searches with helpers
+    const bool pending = DeterministicSMP && thread->nthreads > 1;
+    thread->pending      = pending ? calloc(TT_PENDING_ENTRIES, sizeof(TTPending)) : NULL;
+    thread->pendingUsed  = pending ? malloc(TT_PENDING_ENTRIES * sizeof(uint32_t)) : NULL;
+    thread->pendingCount = 0;
+
+    // Guards the completed lines of split MultiPV searches
+    pthread_mutex_init(&thread->doneLock, NULL);
+
+    // Touch the tables now, rather than from whoever next resets them
+    resetThread(thread);
+
+    return NULL;
+}
+
+Thread* createThreadPool(int nthreads) {
+
+    pthread_t pthread;
+    Thread *threads = allocateThreadPool(nthreads);
+
+    for (int i = 0; i < nthreads; i++) {
 
         // Threads will know of each other
         threads[i].index    = i;
         threads[i].threads  = threads;
         threads[i].nthreads = nthreads;
 
-        // Accumulator stack and table require alignment
-        threads[i].nnue     = nnue_create_evaluator();
+        // Helpers park between searches, while the main thread is the caller
+        if (i > 0) createWorker(&threads[i].worker);
+        if (i > 0) startWorker(&threads[i].worker, initThread, &threads[i]);
     }
 
+    pthread_create(&pthread, NULL, initThread, &threads[0]);
+    pthread_join(pthread, NULL);
+
+    for (int i = 1; i < nthreads; i++)
+        waitWorker(&threads[i].worker);
+
     return threads;
 }
 
 void deleteThreadPool(Thread *threads) {
 
-    for (int i = 0; i < threads->nthreads; i++)
+    const int nthreads = threads->nthreads;
+
+    for (int i = 0; i < nthreads; i++) {
+        if (i > 0) deleteWorker(&threads[i].worker);
         nnue_delete_evaluator(threads[i].nnue);
+        free(threads[i].evcache);
+        free(threads[i].nearBuckets);
+        free(threads[i].pending);
+        free(threads[i].pendingUsed);
+        free(threads[i].pktable);
+        free(threads[i].donePvs);
+        pthread_mutex_destroy(&threads[i].doneLock);
+    }
 
+#if defined(__linux__)
+    munmap(threads, threadPoolBytes(nthreads));
+#else
     free(threads);
+#endif
 }
 
 void resetThreadPool(Thread *threads) {
@@ -69,17 +303,10 @@ void resetThreadPool(Thread *threads) {
     // and evaluation caching. This is needed for ucinewgame
     // calls in order to ensure a deterministic behaviour
 
-    for (int i = 0; i < threads->nthreads; i++) {
-
-        memset(&threads[i].pktable, 0, sizeof(PKTable));
-
-        memset(&threads[i].killers, 0, sizeof(KillerTable));
-        memset(&threads[i].cmtable, 0, sizeof(CounterMoveTable));
+    for (int i = 0; i < threads->nthreads; i++)
+        resetThread(&threads[i]);
 
-        memset(&threads[i].history, 0, sizeof(HistoryTable));
-        memset(&threads[i].chistory, 0, sizeof(CaptureHistoryTable));
-        memset(&threads[i].continuation, 0, sizeof(ContinuationTable));
-    }
+    tt_near_clear(threads);
 }
 
 void newSearchThreadPool(Thread *threads, Board *board, Limits *limits, TimeManager *tm) {
@@ -96,6 +323,7 @@ void newSearchThreadPool(Thread *threads, Board *board, Limits *limits, TimeMana
         threads[i].height = 0;
         threads[i].nodes  = 0ull;
         threads[i].tbhits = 0ull;
+        threads[i].doneDepth = threads[i].doneReported = threads[i].splitCompleted = 0;
 
         memcpy(&threads[i].board, board, sizeof(Board));
         threads[i].board.thread = &threads[i];
@@ -18,7 +18,9 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <setjmp.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -50,6 +52,25 @@ struct NodeState {
     int16_t (*continuations)[CONT_NB][PIECE_NB][SQUARE_NB];
 };
 
+/// A Worker is a long-lived pthread which parks on a condition variable until
+/// it is handed a job, and parks again once the job is done. Every helper of a
+/// Thread pool owns one, as does the UCI search driver, so that starting a new
+/// search only needs to wake them, rather than creating threads each time
+
+struct Worker {
+    pthread_t pthread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    void *(*job)(void*);
+    void *cargo;
+    bool busy, exit;
+};
+
+void createWorker(Worker *worker);
+void deleteWorker(Worker *worker);
+void startWorker(Worker *worker, void *(*job)(void*), void *cargo);
+void waitWorker(Worker *worker);
+
 struct Thread {
 
     Board board;
@@ -58,18 +79,36 @@ struct Thread {
     PVariation pvs[MAX_PLY];
     PVariation mpvs[MAX_MOVES];
 
-    int multiPV;
+    int multiPV, lines;
     uint16_t bestMoves[MAX_MOVES];
 
+    int splits, rootCount;
+    uint16_t rootMoves[MAX_MOVES];
+    atomic_int doneDepth;
+    int doneReported, splitCompleted;
+    pthread_mutex_t doneLock;
+    PVariation *donePvs, splitPvs[MAX_PLY];
+
     uint64_t nodes, tbhits;
     int depth, seldepth, height, completed;
+    TTStats ttstats;
+    SearchStats searchstats;
+    TTBucket *nearBuckets;
+    TTPending *pending;
+    uint32_t *pendingUsed;
+    int pendingCount;
 
     NNUEEvaluator *nnue;
 
+    uint64_t *evcache, evcacheMask;
+    uint64_t evcacheProbes, evcacheHits;
+
+    PKEntry *pktable;
+    uint64_t pkmask;
+
     Undo undoStack[STACK_SIZE];
     NodeState *states, nodeStates[STACK_SIZE];
 
-    ALIGN64 PKTable pktable;
     ALIGN64 KillerTable killers;
     ALIGN64 CounterMoveTable cmtable;
     ALIGN64 HistoryTable history;
@@ -78,6 +117,7 @@ struct Thread {
 
     int index, nthreads;
     Thread *threads;
+    Worker worker;
     jmp_buf jbuffer;
 };
 
@@ -79,34 +79,37 @@ void tm_init(const Limits *limits, TimeManager *tm) {
     }
 }
 
-void tm_update(const Thread *thread, const Limits *limits, TimeManager *tm) {
+void tm_update(const PVariation *pvs, int completed, const Limits *limits, TimeManager *tm) {
 
     // Don't update our Time Managment plans at very low depths
-    if (!limits->limitedBySelf || thread->completed < 4)
+    if (!limits->limitedBySelf || completed < 4)
         return;
 
     // Track how long we've kept the same best move between iterations
-    const uint16_t this_move = thread->pvs[thread->completed-0].line[0];
-    const uint16_t last_move = thread->pvs[thread->completed-1].line[0];
+    const uint16_t this_move = pvs[completed-0].line[0];
+    const uint16_t last_move = pvs[completed-1].line[0];
     tm->pv_stability = (this_move == last_move) ? MIN(10, tm->pv_stability + 1) : 0;
 }
 
-bool tm_finished(const Thread *thread, const TimeManager *tm) {
+bool tm_finished(const PVariation *pvs, int completed, uint64_t nodes, const TimeManager *tm) {
+
+    /// The best lines of each completed depth, and the nodes searched, are those
+    /// of the main thread, or the merged lines of a split MultiPV search
 
     // Don't terminate early at very low depths
-    if (thread->completed < 4) return FALSE;
+    if (completed < 4) return FALSE;
 
     // Scale time between 80% and 120%, based on stable best moves
     const double pv_factor = 1.20 - 0.04 * tm->pv_stability;
 
     // Scale time between 75% and 125%, based on score fluctuations
-    const double score_change = thread->pvs[thread->completed-3].score
-                              - thread->pvs[thread->completed-0].score;
+    const double score_change = pvs[completed-3].score
+                              - pvs[completed-0].score;
     const double score_factor = MAX(0.75, MIN(1.25, 0.05 * score_change));
 
     // Scale time between 50% and 240%, based on where nodes have been spent
-    const uint64_t best_nodes = tm->nodes[thread->pvs[thread->completed-0].line[0]];
-    const double non_best_pct = 1.0 - ((double) best_nodes / thread->nodes);
+    const uint64_t best_nodes = tm->nodes[pvs[completed-0].line[0]];
+    const double non_best_pct = 1.0 - ((double) best_nodes / nodes);
     const double nodes_factor = MAX(0.50, 2 * non_best_pct + 0.4);
 
     return elapsed_time(tm) > tm->ideal_usage * pv_factor * score_factor * nodes_factor;
@@ -40,6 +40,6 @@ struct TimeManager {
 double get_real_time();
 double elapsed_time(const TimeManager *tm);
 void tm_init(const Limits *limits, TimeManager *tm);
-void tm_update(const Thread *thread, const Limits *limits, TimeManager *tm);
-bool tm_finished(const Thread *thread, const TimeManager *tm);
+void tm_update(const PVariation *pvs, int completed, const Limits *limits, TimeManager *tm);
+bool tm_finished(const PVariation *pvs, int completed, uint64_t nodes, const TimeManager *tm);
 bool tm_stop_early(const Thread *thread);
@@ -18,16 +18,51 @@
 /*                                                                            */
 /******************************************************************************/
 
+#include <inttypes.h>
 #include <pthread.h>
+#include <stdio.h>
+
+#if !defined(_WIN32)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define ftell64 ftello
+#else
+    #define ftell64 _ftelli64
+#endif
+
+#if defined(USE_SSSE3)
+    #include <immintrin.h>
+#endif
 
 #include "board.h"
 #include "evaluate.h"
+#include "move.h"
+#include "numa.h"
 #include "thread.h"
 #include "transposition.h"
 #include "types.h"
 #include "zobrist.h"
 
-TTable Table; // Global Transposition Table
+TTable Table = { .placement = USE_NUMA }; // Global Transposition Table
+
+static pthread_t BackgroundThread;  // Resizes or clears the Table for tt_resize_async()
+static bool BackgroundActive;       // Set until the BackgroundThread has been joined
+static struct TTJob BackgroundJob;  // Work for the BackgroundThread to perform
+
+static char ShareName[256];         // Requested shared memory segment, or empty
+static char AttachedName[256];      // Shared memory segment currently mapped
+static int ShareStatus;             // Outcome of the latest attempt to share
+
+static Worker *ClearWorkers[TT_CLEAR_MAX_WORKERS]; // Parked helpers for tt_clear()
+
+#if USE_NUMA
+static _Thread_local uint64_t SliceBase;         // First Bucket of this Thread's slice
+static _Thread_local uint64_t SliceMask = ~0ull; // Mask within the slice, or the whole Table
+#endif
 
 /// Mate and Tablebase scores need to be adjusted relative to the Root
 /// when going into the Table and when coming out of the Table. Otherwise,
@@ -46,46 +81,603 @@ static int tt_value_to(int value, int height) {
 }
 
 
+static uint64_t tt_index(uint64_t hash) {
+#if USE_NUMA
+    return SliceBase + (hash & SliceMask & Table.hashMask);
+#else
+    return hash & Table.hashMask;
+#endif
+}
+
+static size_t tt_bucket_size() {
+    return Table.layout == TT_LAYOUT_64B ? sizeof(TTWideBucket) : sizeof(TTBucket);
+}
+
+static TTEntry* tt_bucket_slots(uint64_t index, int *count) {
+
+    // Provide access to the Entries of a Bucket, regardless of the layout
+
+    if (Table.layout == TT_LAYOUT_64B)
+        return *count = TT_WIDE_BUCKET_NB, Table.wideBuckets[index].slots;
+
+    return *count = TT_BUCKET_NB, Table.buckets[index].slots;
+}
+
+static uint16_t tt_bucket_epoch(uint64_t index) {
+    return Table.layout == TT_LAYOUT_64B ? Table.wideBuckets[index].epoch
+                                         : Table.buckets[index].epoch;
+}
+
+static int tt_bucket_match(TTBucket *bucket, uint16_t key) {
+
+    /// Compare all three 16-bit keys at once, ignoring the epoch in the
+    /// fourth lane. Returns the index of the matching slot, otherwise -1
+
+#if defined(USE_SSSE3)
+    const __m128i keys = _mm_loadl_epi64((const __m128i*) bucket->keys);
+    const __m128i eq   = _mm_cmpeq_epi16(keys, _mm_set1_epi16((short) key));
+    const int mask     = _mm_movemask_epi8(eq) & 0x3F;
+    return mask ? __builtin_ctz(mask) / 2 : -1;
+#else
+    for (int i = 0; i < TT_BUCKET_NB; i++)
+        if (bucket->keys[i] == key) return i;
+    return -1;
+#endif
+}
+
+static int tt_wide_bucket_match(TTWideBucket *bucket, uint32_t key) {
+
+    /// Compare all five 32-bit keys at once. With AVX2, the load spans the keys,
+    /// the epoch, and the first Entry, all of which sit in the same cache line
+
+#if defined(USE_AVX2)
+    const __m256i keys = _mm256_loadu_si256((const __m256i*) bucket->keys);
+    const __m256i eq   = _mm256_cmpeq_epi32(keys, _mm256_set1_epi32((int) key));
+    const int mask     = _mm256_movemask_ps(_mm256_castsi256_ps(eq)) & 0x1F;
+    return mask ? __builtin_ctz(mask) : -1;
+#elif defined(USE_SSSE3)
+    const __m128i needle = _mm_set1_epi32((int) key);
+    const __m128i lower  = _mm_loadu_si128((const __m128i*) &bucket->keys[0]);
+    const __m128i upper  = _mm_loadu_si128((const __m128i*) &bucket->keys[4]);
+    const int mask = (      _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lower, needle)))
+                      | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(upper, needle))) << 4)) & 0x1F;
+    return mask ? __builtin_ctz(mask) : -1;
+#else
+    for (int i = 0; i < TT_WIDE_BUCKET_NB; i++)
+        if (bucket->keys[i] == key) return i;
+    return -1;
+#endif
+}
+
+static TTEntry* tt_lookup(uint64_t hash, int *index, TTEntry **slots, int *count) {
+
+    /// Locate the Bucket for a Zobrist Hash, and search it for a matching key. The
+    /// 16-bit keys are the top bits of the Hash, while the 32-bit keys are the top
+    /// half of the Hash, both of which are independent from the Bucket index bits
+
+    /// Buckets from a previous epoch are logically empty, so they are zeroed
+    /// upon first use. This is equivalent to having cleared the entire Table
+
+    if (Table.layout == TT_LAYOUT_64B) {
+        TTWideBucket *bucket = &Table.wideBuckets[tt_index(hash)];
+        if (bucket->epoch != Table.epoch) *bucket = (TTWideBucket) { .epoch = Table.epoch };
+        *index = tt_wide_bucket_match(bucket, hash >> 32);
+        *slots = bucket->slots, *count = TT_WIDE_BUCKET_NB;
+    }
+
+    else {
+        TTBucket *bucket = &Table.buckets[tt_index(hash)];
+        if (bucket->epoch != Table.epoch) *bucket = (TTBucket) { .epoch = Table.epoch };
+        *index = tt_bucket_match(bucket, hash >> 48);
+        *slots = bucket->slots, *count = TT_BUCKET_NB;
+    }
+
+    return *index >= 0 ? &(*slots)[*index] : NULL;
+}
+
+static TTEntry* tt_near_lookup(Thread *thread, uint64_t hash, int *index, TTEntry **slots, int *count) {
+
+    /// The near Table always uses 32-byte Buckets, and is never invalidated by
+    /// an epoch, since it is cleared alongside the rest of the Thread's tables
+
+    TTBucket *bucket = &thread->nearBuckets[hash & (TT_NEAR_BUCKETS - 1)];
+    *index = tt_bucket_match(bucket, hash >> 48);
+    *slots = bucket->slots, *count = TT_BUCKET_NB;
+    return *index >= 0 ? &(*slots)[*index] : NULL;
+}
+
+static void tt_set_key(uint64_t hash, int index) {
+
+    if (Table.layout == TT_LAYOUT_64B)
+        Table.wideBuckets[tt_index(hash)].keys[index] = (uint32_t) (hash >> 32);
+    else
+        Table.buckets[tt_index(hash)].keys[index] = (uint16_t) (hash >> 48);
+}
+
+
 /// Trivial helper functions to Transposition Table handleing
 
 void tt_update() { Table.generation += TT_MASK_BOUND + 1; }
-void tt_prefetch(uint64_t hash) { __builtin_prefetch(&Table.buckets[hash & Table.hashMask]); }
 
+void tt_prefetch(uint64_t hash) {
+    __builtin_prefetch(Table.layout == TT_LAYOUT_64B
+        ? (void*) &Table.wideBuckets[tt_index(hash)]
+        : (void*) &Table.buckets[tt_index(hash)]);
+}
 
-int tt_init(int nthreads, int megabytes) {
 
-    const uint64_t MB = 1ull << 20;
-    uint64_t keySize = 16ull;
+#if !defined(_WIN32)
 
-    // Cleanup memory when resizing the table
-    if (Table.hashMask) free(Table.buckets);
+static bool tt_share_alive(int32_t pid) {
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
 
-    // Default keysize of 16 bits maps to a 2MB TTable
-    assert((1ull << 16ull) * sizeof(TTBucket) == 2 * MB);
+static bool tt_share_attach(uint64_t bytes) {
 
-    // Find the largest keysize that is still within our given megabytes
-    while ((1ull << keySize) * sizeof(TTBucket) <= megabytes * MB / 2) keySize++;
-    assert((1ull << keySize) * sizeof(TTBucket) <= megabytes * MB);
+    /// Map the Table from the shared memory segment named by ShareName. The first
+    /// process creates the segment, which starts out zeroed, and then publishes the
+    /// header. Later processes wait for the header, and verify that it matches
+
+    const size_t size = TT_FILE_HEADER + bytes;
+    TTShareHeader *header;
+    struct stat st;
+
+    // Exactly one process succeeds in creating the segment
+    int fd = shm_open(ShareName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    const bool created = fd >= 0;
+
+    if (!created) fd = shm_open(ShareName, O_RDWR, 0600);
+
+    if (fd < 0 || (created && ftruncate(fd, size))) {
+        if (created) shm_unlink(ShareName);
+        if (fd >= 0) close(fd);
+        return ShareStatus = TT_SHARE_ERROR, false;
+    }
+
+    // Give the creator a moment to size the segment
+    for (int tries = 0; !fstat(fd, &st) && st.st_size == 0 && tries < 1000; tries++)
+        usleep(1000);
+
+    if ((size_t) st.st_size != size)
+        return close(fd), ShareStatus = TT_SHARE_MISMATCH, false;
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the segment open
+
+    if (header == MAP_FAILED)
+        return ShareStatus = TT_SHARE_ERROR, false;
+
+    if (created) {
+        header->table = (TTFileHeader) {
+            .magic = "Ethereal", .version = TT_FILE_VERSION, .layout = Table.layout,
+            .buckets = bytes / tt_bucket_size(), .bucketSize = tt_bucket_size(),
+        };
+        __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+    }
+
+    // Wait for the creator to publish the header
+    for (int tries = 0; !__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) && tries < 1000; tries++)
+        usleep(1000);
+
+    if (   !__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE)
+        || header->table.version != TT_FILE_VERSION
+        || header->table.layout != (uint32_t) Table.layout
+        || header->table.buckets != bytes / tt_bucket_size()
+        || header->table.bucketSize != tt_bucket_size())
+        return munmap(header, size), ShareStatus = TT_SHARE_MISMATCH, false;
+
+    // Claim a slot for our process id, removing any processes that have died
+    int32_t self = getpid(), expected;
+    bool claimed = false;
+
+    for (int i = 0; i < TT_SHARE_MAX_PROCS && !claimed; i++) {
+
+        if ((expected = header->pids[i]) && !tt_share_alive(expected))
+            __atomic_compare_exchange_n(&header->pids[i], &expected, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+        expected = 0;
+        claimed = __atomic_compare_exchange_n(&header->pids[i], &expected, self, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+
+    if (!claimed)
+        return munmap(header, size), ShareStatus = TT_SHARE_ERROR, false;
+
+    // Shared Tables never advance the epoch, so every process must use the first
+    // one. Otherwise each process would zero the Buckets stored by the others
+    strcpy(AttachedName, ShareName);
+    Table.buckets    = (void*) ((char*) header + TT_FILE_HEADER);
+    Table.allocation = TT_ALLOC_SHARED;
+    Table.epoch      = 0;
+    return ShareStatus = created ? TT_SHARE_CREATED : TT_SHARE_ATTACHED, true;
+}
+
+static void tt_share_detach() {
+
+    /// Release our slot in the header, and unlink the segment if no other live
+    /// processes remain. Processes which attach later will create a new segment
+
+    TTShareHeader *header = (TTShareHeader*) ((char*) Table.buckets - TT_FILE_HEADER);
+    int32_t self = getpid(), expected;
+    bool alone = true;
+
+    for (int i = 0; i < TT_SHARE_MAX_PROCS; i++) {
+
+        if ((expected = header->pids[i]) == self || (expected && !tt_share_alive(expected)))
+            __atomic_compare_exchange_n(&header->pids[i], &expected, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+        alone = alone && !__atomic_load_n(&header->pids[i], __ATOMIC_SEQ_CST);
+    }
+
+    munmap(header, TT_FILE_HEADER + Table.bytes);
+    if (alone) shm_unlink(AttachedName);
+}
+
+static void tt_share_exit() {
+
+    // Registered with atexit(), to detach when the process finishes
+    if (Table.allocation == TT_ALLOC_SHARED)
+        tt_share_detach(), Table.allocation = TT_ALLOC_HEAP, Table.buckets = NULL;
+}
+
+#endif
+
+static void tt_free() {
+
+#if !defined(_WIN32)
+    if (Table.allocation == TT_ALLOC_SHARED) {
+        tt_share_detach();
+        return;
+    }
+
+    if (Table.allocation != TT_ALLOC_HEAP) {
+        munmap(Table.buckets, Table.bytes);
+        return;
+    }
+#endif
+
+    free(Table.buckets);
+}
+
+static void tt_allocate(uint64_t bytes) {
+
+    Table.allocation = TT_ALLOC_HEAP;
 
 #if defined(__linux__) && !defined(__ANDROID__)
 
-    // On Linux systems we align on 2MB boundaries and request Huge Pages
-    Table.buckets = aligned_alloc(2 * MB, (1ull << keySize) * sizeof(TTBucket));
-    madvise(Table.buckets, (1ull << keySize) * sizeof(TTBucket), MADV_HUGEPAGE);
+    #if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+
+    // Attempt to reserve explicit huge pages, first 1GB and then 2MB pages
+    for (int shift = bytes >= (1ull << 30) ? 30 : 21; shift >= 21; shift -= 9) {
+
+        void *buckets = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+
+        if (buckets != MAP_FAILED) {
+            Table.buckets = buckets, Table.allocation = TT_ALLOC_HUGETLB;
+            return;
+        }
+    }
+
+    #endif
+
+    // Otherwise we align on 2MB boundaries and request Transparent Huge Pages
+    Table.buckets = aligned_alloc(1ull << 21, bytes);
+    madvise(Table.buckets, bytes, MADV_HUGEPAGE);
 #else
 
     // Otherwise, we simply allocate as usual and make no requests
-    Table.buckets = malloc((1ull << keySize) * sizeof(TTBucket));
+    Table.buckets = malloc(bytes);
+#endif
+}
+
+static void tt_resize(int megabytes) {
+
+    const uint64_t MB = 1ull << 20;
+    const uint64_t bucketSize = tt_bucket_size();
+    uint64_t keySize = 1ull;
+
+    // Cleanup memory when resizing the table
+    if (Table.hashMask) tt_free();
+
+    // Both layouts pack their Buckets into exactly half or a full cache line
+    assert(sizeof(TTBucket) == 32 && sizeof(TTWideBucket) == 64);
+
+    // Smallest keysize which maps to a 2MB TTable for the Bucket layout
+    while ((1ull << keySize) * bucketSize < 2 * MB) keySize++;
+
+    // Find the largest keysize that is still within our given megabytes
+    while ((1ull << keySize) * bucketSize <= megabytes * MB / 2) keySize++;
+    assert((1ull << keySize) * bucketSize <= MAX(2, megabytes) * MB);
+
+    // Share the Table with other processes when requested. Otherwise, use
+    // huge pages when possible, and the system's normal pages otherwise
+#if !defined(_WIN32)
+    if (!ShareName[0] || !tt_share_attach((1ull << keySize) * bucketSize))
 #endif
+        tt_allocate((1ull << keySize) * bucketSize);
 
     // Save the lookup mask
     Table.hashMask = (1ull << keySize) - 1u;
+    Table.bytes    = (1ull << keySize) * bucketSize;
+
+    // Local placement needs exactly one slice per node, each at least 2MB and a
+    // power of two in size. Otherwise the Table is interleaved across the nodes
+    const int nodes = numa_node_count();
+    Table.slices = Table.placement == NUMA_LOCAL && !(nodes & (nodes - 1))
+                && (uint64_t) nodes * 2 * MB <= Table.bytes ? nodes : 1;
+
+    Table.sliceMask = (Table.hashMask + 1) / Table.slices - 1;
+}
+
+static void tt_clear_with(int nworkers);
+
+int tt_init(int nthreads, int megabytes) {
 
-    // Clear the table and load everything into the cache
-    tt_clear(nthreads);
+    // Allocate, then clear the table and load everything into the cache.
+    // Shared Tables start out zeroed, and may already be in use elsewhere
+    tt_resize(megabytes);
+    if (Table.allocation != TT_ALLOC_SHARED) tt_clear(nthreads);
 
     // Return the number of MB actually allocated for the TTable
-    return ((Table.hashMask + 1) * sizeof(TTBucket)) / MB;
+    return tt_megabytes();
+}
+
+static void *tt_background(void *cargo) {
+
+    // Resize when requested, and clear the Table using every available CPU
+    if (!BackgroundJob.clearOnly) tt_resize(BackgroundJob.megabytes);
+    if (BackgroundJob.clearOnly || Table.allocation != TT_ALLOC_SHARED)
+        tt_clear_with(numa_cpu_count());
+
+    if (BackgroundJob.done != NULL) BackgroundJob.done();
+    return cargo;
+}
+
+static void tt_start_job(struct TTJob job) {
+
+    tt_wait(); // At most one pending job
+
+    BackgroundJob = job;
+    BackgroundActive = true;
+    pthread_create(&BackgroundThread, NULL, tt_background, NULL);
+}
+
+void tt_resize_async(int megabytes, void (*done)()) {
+
+    /// Resize and clear the Table on a background thread, returning at once. This
+    /// keeps the UCI loop responsive for very large Tables. Anything touching the
+    /// Table, such as starting a search, must first call tt_wait(). Once finished,
+    /// the optional callback is made from the background thread
+
+    tt_start_job((struct TTJob) { false, megabytes, done });
+}
+
+void tt_clear_async() {
+    tt_start_job((struct TTJob) { true, 0, NULL });
+}
+
+void tt_wait() {
+
+    // Block until any pending resize or clear of the Table has completed
+    if (BackgroundActive)
+        pthread_join(BackgroundThread, NULL), BackgroundActive = false;
+}
+
+void tt_invalidate() {
+
+    // Make every Entry logically invalid by advancing the epoch, but fall
+    // back to a physical clear once all of the 16-bit epochs are exhausted
+    tt_wait();
+
+    if (Table.allocation != TT_ALLOC_SHARED && ++Table.epoch == 0)
+        tt_clear_async();
+}
+
+int tt_share(int nthreads, const char *name) {
+
+    /// Begin sharing the Table through the named segment, or stop sharing the
+    /// Table when the name is empty. Either way the Table is reallocated, and
+    /// we return whether we created, attached to, or failed to use the segment
+
+    static bool registered = false;
+
+    tt_wait(); // Finish any pending resize
+
+    ShareName[0] = '\0', ShareStatus = TT_SHARE_OFF;
+
+#if !defined(_WIN32)
+
+    // POSIX names for shared memory segments begin with a slash
+    if (name[0] != '\0')
+        snprintf(ShareName, sizeof(ShareName), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    if (!registered) atexit(tt_share_exit), registered = true;
+
+#else
+    ShareStatus = name[0] != '\0' ? TT_SHARE_ERROR : TT_SHARE_OFF;
+    (void) registered;
+#endif
+
+    tt_init(nthreads, tt_megabytes());
+    return ShareStatus;
+}
+
+int tt_share_status() {
+    return ShareStatus;
+}
+
+void tt_numa_attach(int index, int nthreads) {
+
+    /// With node-local placement, point each Thread at the slice of the Table which
+    /// was placed on its node. Threads already bound by bindThisThread() keep their
+    /// node. Others are split into contiguous groups, and bound to one node each.
+    /// Otherwise, all of the Threads share every Bucket of the Table. Threads which
+    /// never attach, such as the UCI thread, index the entire Table
+
+#if USE_NUMA
+
+    int node = Table.slices > 1 ? numa_thread_node() : 0;
+
+    if (node < 0) {
+        node = index * numa_node_count() / nthreads;
+        numa_bind_node(node);
+    }
+
+    // There is a slice for every node, or a single slice covering the Table
+    assert(0 <= node && node < Table.slices);
+    SliceBase = (uint64_t) node * (Table.sliceMask + 1);
+    SliceMask = Table.sliceMask;
+
+#else
+    (void) index; (void) nthreads;
+#endif
+}
+
+int tt_megabytes() {
+    return Table.bytes / (1ull << 20);
+}
+
+int tt_save(const char *fname) {
+
+    /// Write the header, padded out to TT_FILE_HEADER bytes, followed by the
+    /// entire Table. The header is padded so that the Buckets remain aligned
+    /// to any page size, allowing tt_load() to map them straight from disk
+
+    TTFileHeader header = {
+        .magic = "Ethereal",   .version = TT_FILE_VERSION,
+        .layout = Table.layout, .buckets = Table.hashMask + 1,
+        .bucketSize = tt_bucket_size(), .epoch = Table.epoch,
+        .generation = Table.generation,
+    };
+
+    FILE *fout = fopen(fname, "wb");
+    char *page = calloc(1, TT_FILE_HEADER);
+    bool okay  = fout != NULL && page != NULL;
+
+    memcpy(page, &header, sizeof(TTFileHeader));
+    okay = okay && fwrite(page, 1, TT_FILE_HEADER, fout) == TT_FILE_HEADER;
+    okay = okay && fwrite(Table.buckets, 1, Table.bytes, fout) == Table.bytes;
+
+    if (fout != NULL) okay = !fclose(fout) && okay;
+    free(page);
+
+    return okay ? TT_FILE_OK : TT_FILE_IO_ERROR;
+}
+
+int tt_load(const char *fname) {
+
+    /// Verify the header against the current Table, and then replace the Table
+    /// with the Buckets from the file. When possible, we map a private copy of
+    /// the file, so that restoring even a huge Table is almost instantaneous.
+    /// Tables using huge pages or NUMA placement are read into instead, so as
+    /// to keep their pages, and a Table shared with other processes is never
+    /// replaced underneath them
+
+    TTFileHeader header;
+
+    if (Table.allocation == TT_ALLOC_SHARED)
+        return TT_FILE_SHARED;
+
+    FILE *fin = fopen(fname, "rb");
+
+    if (fin == NULL)
+        return TT_FILE_IO_ERROR;
+
+    if (   fread(&header, sizeof(TTFileHeader), 1, fin) != 1
+        || memcmp(header.magic, "Ethereal", sizeof(header.magic))
+        || header.version != TT_FILE_VERSION)
+        return fclose(fin), TT_FILE_BAD_HEADER;
+
+    if (   header.layout != (uint32_t) Table.layout
+        || header.buckets != Table.hashMask + 1
+        || header.bucketSize != tt_bucket_size())
+        return fclose(fin), TT_FILE_MISMATCH;
+
+    // The file must contain the entire Table after the header
+    if (   fseek(fin, 0, SEEK_END)
+        || (uint64_t) ftell64(fin) != TT_FILE_HEADER + Table.bytes)
+        return fclose(fin), TT_FILE_TRUNCATED;
+
+#if !defined(_WIN32)
+
+    // Map a copy-on-write view of the Buckets, and hint to the OS that
+    // there is no point in reading ahead of the Buckets which we touch
+    if (Table.allocation != TT_ALLOC_HUGETLB && Table.placement == NUMA_OFF) {
+
+        void *buckets = mmap(NULL, Table.bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE, fileno(fin), TT_FILE_HEADER);
+        fclose(fin);
+
+        if (buckets == MAP_FAILED)
+            return TT_FILE_IO_ERROR;
+
+        madvise(buckets, Table.bytes, MADV_RANDOM);
+        tt_free(); // Release the previous Buckets
+
+        Table.buckets    = buckets;
+        Table.allocation = TT_ALLOC_FILE;
+        Table.epoch      = header.epoch;
+        Table.generation = header.generation;
+        return TT_FILE_OK;
+    }
+
+#endif
+
+    // Otherwise, read the Buckets directly into the existing Table
+    bool okay = !fseek(fin, TT_FILE_HEADER, SEEK_SET)
+             && fread(Table.buckets, 1, Table.bytes, fin) == Table.bytes;
+    fclose(fin);
+
+    if (!okay) return TT_FILE_IO_ERROR;
+
+    Table.epoch      = header.epoch;
+    Table.generation = header.generation;
+    return TT_FILE_OK;
+}
+
+uint64_t tt_page_size(int *percent) {
+
+    /// Determine the size of the pages backing the Table, and the percent of the
+    /// Table which they cover. Transparent Huge Pages are granted piecemeal by the
+    /// kernel, so on Linux we inspect our own mapping of the Table in smaps
+
+    uint64_t pageSize = 4096, hugeBytes = 0;
+    *percent = 100;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+    char line[256];
+    uint64_t begin, end, kilobytes;
+    uint64_t address = (uint64_t) Table.buckets;
+    FILE *fin = fopen("/proc/self/smaps", "r");
+    bool inside = false;
+
+    while (fin != NULL && fgets(line, sizeof(line), fin) != NULL) {
+
+        // Each mapping starts with a line for the range of addresses
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " ", &begin, &end) == 2) {
+            if (inside) break;
+            inside = begin <= address && address < end;
+        }
+
+        else if (inside && sscanf(line, "KernelPageSize: %" SCNu64, &kilobytes) == 1)
+            pageSize = kilobytes * 1024;
+
+        else if (inside && sscanf(line, "AnonHugePages: %" SCNu64, &kilobytes) == 1)
+            hugeBytes = kilobytes * 1024;
+    }
+
+    if (fin != NULL) fclose(fin);
+
+    // Transparent Huge Pages show up separately from the normal page size
+    if (hugeBytes > 0) {
+        *percent = (int) MIN(100, 100 * hugeBytes / Table.bytes);
+        return 2ull << 20;
+    }
+
+#endif
+
+    return pageSize;
 }
 
 int tt_hashfull() {
@@ -93,101 +685,297 @@ int tt_hashfull() {
     /// Estimate the permill of the table being used, by looking at a thousand
     /// Buckets and seeing how many Entries contain a recent Transposition.
 
-    int used = 0;
+    int used = 0, count;
+
+    for (int i = 0; i < 1000; i++) {
+
+        TTEntry *slots = tt_bucket_slots(i, &count);
 
-    for (int i = 0; i < 1000; i++)
-        for (int j = 0; j < TT_BUCKET_NB; j++)
-            used += (Table.buckets[i].slots[j].generation & TT_MASK_BOUND) != BOUND_NONE
-                 && (Table.buckets[i].slots[j].generation & TT_MASK_AGE) == Table.generation;
+        if (tt_bucket_epoch(i) != Table.epoch)
+            continue;
 
-    return used / TT_BUCKET_NB;
+        for (int j = 0; j < count; j++)
+            used += (slots[j].generation & TT_MASK_BOUND) != BOUND_NONE
+                 && (slots[j].generation & TT_MASK_AGE) == Table.generation;
+    }
+
+    return used / count;
+}
+
+static TTEntry* tt_pending_lookup(Thread *thread, uint64_t hash) {
+
+    // Pending stores are direct mapped, and keep the full Hash
+    TTPending *slot = &thread->pending[hash & (TT_PENDING_ENTRIES - 1)];
+    return slot->hash == hash ? &slot->entry : NULL;
 }
 
-bool tt_probe(uint64_t hash, int height, uint16_t *move, int *value, int *eval, int *depth, int *bound) {
+static void tt_pending_store(Thread *thread, uint64_t hash, uint16_t move, int value, int eval, int depth, int bound) {
+
+    TTPending *slot = &thread->pending[hash & (TT_PENDING_ENTRIES - 1)];
+    const bool matched = slot->hash == hash;
+
+    // Keep a deeper Entry of the same position, as the shared Table would
+    if (matched && bound != BOUND_EXACT && depth < slot->entry.depth - 2)
+        return;
+
+    // Remember the order in which slots were first used, to replay them
+    if (!slot->hash && thread->pendingCount < TT_PENDING_ENTRIES)
+        thread->pendingUsed[thread->pendingCount++] = slot - thread->pending;
+
+    if (move || !matched)
+        slot->entry.move = move;
+
+    slot->hash             = hash;
+    slot->entry.depth      = (int8_t  ) depth;
+    slot->entry.generation = (uint8_t ) bound | Table.generation;
+    slot->entry.value      = (int16_t ) value;
+    slot->entry.eval       = (int16_t ) eval;
+}
+
+bool tt_probe(Thread *thread, uint64_t hash, uint16_t *move, int *value, int *eval, int *depth, int *bound) {
 
     /// Search for a Transposition matching the provided Zobrist Hash. If one is found,
     /// we update its age in order to indicate that it is still relevant, before copying
     /// over its contents and signaling to the caller that an Entry was found.
 
-    const uint16_t hash16 = hash >> 48;
-    TTEntry *slots = Table.buckets[hash & Table.hashMask].slots;
+    int index, count;
+    TTEntry *slots, *near, *entry = NULL;
 
-    for (int i = 0; i < TT_BUCKET_NB; i++) {
+    TT_STAT(thread, probes);
 
-        if (slots[i].hash16 == hash16) {
+    // Deterministic searches see their own stores from this iteration first
+    if (thread->pending != NULL)
+        entry = tt_pending_lookup(thread, hash);
 
-            slots[i].generation = Table.generation | (slots[i].generation & TT_MASK_BOUND);
+    if (entry == NULL)
+        entry = tt_lookup(hash, &index, &slots, &count);
 
-            *move  = slots[i].move;
-            *value = tt_value_from(slots[i].value, height);
-            *eval  = slots[i].eval;
-            *depth = slots[i].depth;
-            *bound = slots[i].generation & TT_MASK_BOUND;
-            return TRUE;
-        }
-    }
+    // Shallow Entries live in the near Table, when one is in use. Take
+    // the deeper of the two Entries, should both Tables contain the Hash
+    if (    thread->nearBuckets != NULL
+        && (entry == NULL || entry->depth < Table.nearDepth)
+        && (near = tt_near_lookup(thread, hash, &index, &slots, &count)) != NULL
+        && (entry == NULL || near->depth >= entry->depth))
+        entry = near, TT_STAT(thread, nearHits);
+
+    if (entry == NULL)
+        return FALSE;
+
+    TT_STAT(thread, hits);
+
+#ifdef USE_STATS
+    // A move which is not even pseudo legal reveals a collision of the keys
+    if (entry->move && !moveIsPseudoLegal(&thread->board, entry->move))
+        TT_STAT(thread, falseHits);
+#endif
+
+    entry->generation = Table.generation | (entry->generation & TT_MASK_BOUND);
 
-    return FALSE;
+    *move  = entry->move;
+    *value = tt_value_from(entry->value, thread->height);
+    *eval  = entry->eval;
+    *depth = entry->depth;
+    *bound = entry->generation & TT_MASK_BOUND;
+    return TRUE;
 }
 
-void tt_store(uint64_t hash, int height, uint16_t move, int value, int eval, int depth, int bound) {
+static void tt_store_slot(Thread *thread, uint64_t hash, uint16_t move, int value, int eval, int depth, int bound, bool near) {
 
-    int i;
-    const uint16_t hash16 = hash >> 48;
-    TTEntry *slots = Table.buckets[hash & Table.hashMask].slots;
-    TTEntry *replace = slots; // &slots[0]
+    /// Place an Entry into the shared Table, or into the near Table of the Thread.
+    /// The value has already been adjusted relative to the Root by the caller
 
-    // Find a matching hash, or replace using MIN(x1, x2, x3),
+    int index, count;
+    TTEntry *slots, *replace;
+
+    replace = near ? tt_near_lookup(thread, hash, &index, &slots, &count)
+                   : tt_lookup(hash, &index, &slots, &count);
+    const bool matched = replace != NULL;
+
+    TT_STAT(thread, stores);
+    if (near) TT_STAT(thread, nearStores);
+
+    // Prefer a matching hash, otherwise replace using MIN(x1, x2, ... xN),
     // where xN equals the depth minus 4 times the age difference
-    for (i = 0; i < TT_BUCKET_NB && slots[i].hash16 != hash16; i++)
-        if (   replace->depth - ((259 + Table.generation - replace->generation) & TT_MASK_AGE)
-            >= slots[i].depth - ((259 + Table.generation - slots[i].generation) & TT_MASK_AGE))
-            replace = &slots[i];
+    if (!matched) {
+
+        replace = slots; // &slots[0]
+
+        for (int i = 1; i < count; i++)
+            if (   replace->depth - ((259 + Table.generation - replace->generation) & TT_MASK_AGE)
+                >= slots[i].depth - ((259 + Table.generation - slots[i].generation) & TT_MASK_AGE))
+                replace = &slots[i];
 
-    // Prefer a matching hash, otherwise score a replacement
-    replace = (i != TT_BUCKET_NB) ? &slots[i] : replace;
+        if (!replace->generation && !replace->depth && !replace->move)
+            TT_STAT(thread, fills);
+        else if ((replace->generation & TT_MASK_AGE) != Table.generation)
+            TT_STAT(thread, replacedAge);
+        else
+            TT_STAT(thread, replacedDepth);
+    }
 
     // Don't overwrite an entry from the same position, unless we have
     // an exact bound or depth that is nearly as good as the old one
     if (   bound != BOUND_EXACT
-        && hash16 == replace->hash16
-        && depth < replace->depth - 2)
+        && matched
+        && depth < replace->depth - 2) {
+        TT_STAT(thread, skips);
         return;
+    }
+
+    if (matched) TT_STAT(thread, updates);
 
     // Don't overwrite a move if we don't have a new one
-    if (move || hash16 != replace->hash16)
+    if (move || !matched)
         replace->move = (uint16_t) move;
 
     // Finally, copy the new data into the replaced slot
     replace->depth      = (int8_t  ) depth;
     replace->generation = (uint8_t ) bound | Table.generation;
-    replace->value      = (int16_t ) tt_value_to(value, height);
+    replace->value      = (int16_t ) value;
     replace->eval       = (int16_t ) eval;
-    replace->hash16     = (uint16_t) hash16;
+
+    if (near)
+        thread->nearBuckets[hash & (TT_NEAR_BUCKETS - 1)].keys[replace - slots] = (uint16_t) (hash >> 48);
+    else
+        tt_set_key(hash, replace - slots);
+}
+
+void tt_store(Thread *thread, uint64_t hash, uint16_t move, int value, int eval, int depth, int bound) {
+
+    // Deterministic searches hold back their stores until the iteration ends
+    if (thread->pending != NULL) {
+        tt_pending_store(thread, hash, move, tt_value_to(value, thread->height), eval, depth, bound);
+        return;
+    }
+
+    // Shallow Entries are kept out of the shared Table, when possible
+    const bool near = depth < Table.nearDepth && thread->nearBuckets != NULL;
+    tt_store_slot(thread, hash, move, tt_value_to(value, thread->height), eval, depth, bound, near);
+}
+
+void tt_pending_flush(Thread *threads) {
+
+    /// Move the pending stores of every Thread into the shared Table. This must
+    /// only be called while no Thread is searching. Threads are visited in order,
+    /// as are their stores, so the resulting Table is always the same
+
+    for (int i = 0; i < threads->nthreads; i++) {
+
+        Thread *const thread = &threads[i];
+
+        if (thread->pending == NULL)
+            continue;
+
+        for (int j = 0; j < thread->pendingCount; j++) {
+
+            TTPending *slot = &thread->pending[thread->pendingUsed[j]];
+
+            if (slot->hash)
+                tt_store_slot(thread, slot->hash, slot->entry.move, slot->entry.value, slot->entry.eval,
+                    slot->entry.depth, slot->entry.generation & TT_MASK_BOUND, false);
+
+            *slot = (TTPending) {0};
+        }
+
+        thread->pendingCount = 0;
+    }
+}
+
+void tt_print_stats(Thread *threads, const char *prefix) {
+
+    /// Sum up the counters of every Thread, and report the rates for each. The
+    /// same format is used at the end of bench and for the hashstats command
+
+    TTStats total = {0};
+
+    for (int i = 0; i < threads->nthreads; i++) {
+        const TTStats *stats = &threads[i].ttstats;
+        total.probes    += stats->probes;    total.hits          += stats->hits;
+        total.falseHits += stats->falseHits; total.stores        += stats->stores;
+        total.updates   += stats->updates;   total.skips         += stats->skips;
+        total.fills     += stats->fills;     total.replacedAge   += stats->replacedAge;
+        total.replacedDepth += stats->replacedDepth;
+        total.nearHits  += stats->nearHits;  total.nearStores    += stats->nearStores;
+        total.pkProbes  += stats->pkProbes;  total.pkHits        += stats->pkHits;
+    }
+
+    const double probes = MAX(1, total.probes), stores = MAX(1, total.stores);
+
+    printf("%sTT Probes %12"PRIu64"  Hits     %6.2f%%  False Hits %9.3f ppm\n", prefix,
+        total.probes, 100.0 * total.hits / probes, 1e6 * total.falseHits / probes);
+
+    printf("%sTT Stores %12"PRIu64"  Updates  %6.2f%%  Skips      %9.2f%%\n", prefix,
+        total.stores, 100.0 * total.updates / stores, 100.0 * total.skips / stores);
+
+    printf("%sTT Misses %12"PRIu64"  Fills    %6.2f%%  Aged Evict %9.2f%%  Depth Evict %6.2f%%\n", prefix,
+        total.fills + total.replacedAge + total.replacedDepth, 100.0 * total.fills / stores,
+        100.0 * total.replacedAge / stores, 100.0 * total.replacedDepth / stores);
+
+    if (total.nearStores)
+        printf("%sTT Near   %12"PRIu64"  Hits     %6.2f%%  Stores     %9.2f%%\n", prefix,
+            total.nearHits, 100.0 * total.nearHits / probes, 100.0 * total.nearStores / stores);
+
+    if (total.pkProbes)
+        printf("%sPK Probes %12"PRIu64"  Hits     %6.2f%%  Entries    %9"PRIu64"\n", prefix,
+            total.pkProbes, 100.0 * total.pkHits / total.pkProbes, threads->pkmask + 1);
+}
+
+TTBucket* tt_near_create() {
+
+    // Only allocate near Tables when they will be used
+    if (Table.nearDepth <= 0)
+        return NULL;
+
+    TTBucket *buckets = aligned_alloc(64, TT_NEAR_BUCKETS * sizeof(TTBucket));
+    return memset(buckets, 0, TT_NEAR_BUCKETS * sizeof(TTBucket));
+}
+
+void tt_near_clear(Thread *threads) {
+
+    for (int i = 0; i < threads->nthreads; i++)
+        if (threads[i].nearBuckets != NULL)
+            memset(threads[i].nearBuckets, 0, TT_NEAR_BUCKETS * sizeof(TTBucket));
 }
 
 
 void tt_clear(int nthreads) {
 
     // Only use 1/4th of the enabled search Threads
-    int nworkers = MAX(1, nthreads / 4);
-    pthread_t pthreads[nworkers];
+    tt_clear_with(MAX(1, nthreads / 4));
+}
+
+static void tt_clear_with(int nworkers) {
+
+    // When placing pages on NUMA nodes, give every node the same number of workers
+    const int groups = Table.placement != NUMA_OFF ? numa_node_count() : 1;
+    nworkers = groups * ((MIN(nworkers, TT_CLEAR_MAX_WORKERS - groups) + groups - 1) / groups);
+
+    // Workers bind themselves to a node, so avoid reusing this thread
+    const int reuse = groups == 1;
+
     struct TTClear ttclears[nworkers];
 
-    // Initalize the data passed via a void* in pthread_create()
+    // Initalize the data passed via a void* to each Worker
     for (int i = 0; i < nworkers; i++)
         ttclears[i] = (struct TTClear) { i, nworkers };
 
-    // Launch each of the helper threads to clear their sections
-    for (int i = 1; i < nworkers; i++)
-        pthread_create(&pthreads[i], NULL, tt_clear_threaded, &ttclears[i]);
+    // Wake each of the helpers to clear their sections, creating any missing
+    // ones. A Worker always serves the same index, and thus the same node
+    for (int i = reuse; i < nworkers; i++) {
+        if (ClearWorkers[i] == NULL)
+            createWorker(ClearWorkers[i] = malloc(sizeof(Worker)));
+        startWorker(ClearWorkers[i], tt_clear_threaded, &ttclears[i]);
+    }
 
     // Reuse this thread for the 0th sections of the Transposition Table
-    tt_clear_threaded((void*) &ttclears[0]);
+    if (reuse) tt_clear_threaded((void*) &ttclears[0]);
 
-    // Join each of the helper threads after they've cleared their sections
-    for (int i = 1; i < nworkers; i++)
-        pthread_join(pthreads[i], NULL);
+    // Wait for each of the helpers to park after they've cleared their sections
+    for (int i = reuse; i < nworkers; i++)
+        waitWorker(ClearWorkers[i]);
+
+    // Every Bucket now belongs to the first epoch
+    Table.epoch = 0;
 }
 
 void *tt_clear_threaded(void *cargo) {
@@ -195,14 +983,38 @@ void *tt_clear_threaded(void *cargo) {
     const uint64_t MB = 1ull << 20;
     struct TTClear *ttclear = (struct TTClear*) cargo;
 
-    // Logic for dividing the Table taken from Weiss and CFish
-    const uint64_t size   = (Table.hashMask + 1) * sizeof(TTBucket);
-    const uint64_t slice  = (size + ttclear->count - 1) / ttclear->count;
-    const uint64_t blocks = (slice + 2 * MB - 1) / (2 * MB);
-    const uint64_t begin  = MIN(size, ttclear->index * blocks * 2 * MB);
-    const uint64_t end    = MIN(size, begin + blocks * 2 * MB);
+    // Workers are split evenly into groups, one for each NUMA node
+    const int groups  = Table.placement != NUMA_OFF ? numa_node_count() : 1;
+    const int local   = Table.placement == NUMA_LOCAL && Table.slices == groups;
+    const int node    = ttclear->index % groups;
+    const int rank    = ttclear->index / groups;
+    const int workers = ttclear->count / groups;
+
+    // The Table is always a whole number of 2MB blocks
+    const uint64_t size   = (Table.hashMask + 1) * tt_bucket_size();
+    const uint64_t blocks = size / (2 * MB);
+
+    // Each node owns either a contiguous slice, every Nth block, or everything.
+    // Local placement without a slice for each node falls back to interleaving
+    const uint64_t owned = local                       ? blocks / Table.slices
+                         : Table.placement != NUMA_OFF ? (blocks - node + groups - 1) / groups
+                         : blocks;
+
+    // Logic for dividing the work taken from Weiss and CFish
+    const uint64_t begin = rank * owned / workers;
+    const uint64_t end   = (rank + 1) * owned / workers;
+
+    // The first touch of a page decides which node it will reside on
+    if (groups > 1) numa_bind_node(node);
+
+    for (uint64_t i = begin; i < end; i++) {
+
+        const uint64_t block = local                       ? node * owned + i
+                             : Table.placement != NUMA_OFF ? i * groups + node : i;
+
+        memset((char*) Table.buckets + block * 2 * MB, 0, 2 * MB);
+    }
 
-    memset(Table.buckets + begin / sizeof(TTBucket), 0, end - begin);
     return NULL;
 }
 
@@ -210,11 +1022,25 @@ void *tt_clear_threaded(void *cargo) {
 /// safety information for use in King Safety, when not using NNUE evaluations
 
 PKEntry* getCachedPawnKingEval(Thread *thread, const Board *board) {
-    PKEntry *pke = &thread->pktable[board->pkhash & PK_CACHE_MASK];
-    return pke->pkhash == board->pkhash ? pke : NULL;
+
+    if (thread->pktable == NULL)
+        return NULL;
+
+    PKEntry *pke = &thread->pktable[board->pkhash & thread->pkmask];
+    TT_STAT(thread, pkProbes);
+
+    if (pke->pkhash != (uint32_t) (board->pkhash >> 32))
+        return NULL;
+
+    TT_STAT(thread, pkHits);
+    return pke;
 }
 
 void storeCachedPawnKingEval(Thread *thread, const Board *board, uint64_t passed, int eval, int safety[2]) {
-    PKEntry *pke = &thread->pktable[board->pkhash & PK_CACHE_MASK];
-    *pke = (PKEntry) { board->pkhash, passed, eval, safety[WHITE], safety[BLACK] };
+
+    if (thread->pktable == NULL)
+        return;
+
+    PKEntry *pke = &thread->pktable[board->pkhash & thread->pkmask];
+    *pke = (PKEntry) { passed, board->pkhash >> 32, eval, safety[WHITE], safety[BLACK] };
 }
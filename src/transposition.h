@@ -37,10 +37,23 @@
 /// additional Zobrist bits. An Entry may also contain a static evaluation for
 /// the node, a search evaluation for the node, and a best move at that node.
 ///
-/// Each Entry contains 10-bytes of information. We group together entries into
-/// Buckets, containing three Entries a piece, as well as 2 additional bytes to
-/// pad out the structure to 32-bytes. This gives us multiple options when we
-/// run into a Zobrist collision with the Transposition Table lookup key.
+/// Each Entry contains 8-bytes of information. We group together entries into
+/// Buckets, and keep the Zobrist verification keys for a Bucket apart from the
+/// Entries themselves, so that all of the keys may be checked with one vector
+/// compare. This gives us multiple options when we run into a Zobrist collision
+/// with the Transposition Table lookup key. Two Bucket layouts are supported:
+///
+///  [1] 32-byte Buckets, holding three Entries with 16-bit verification keys, as
+///      well as a 16-bit epoch in place of padding. This is the default.
+///  [2] 64-byte Buckets, filling an entire cache line with five Entries and much
+///      wider 32-bit verification keys. Fewer Entries fit into each megabyte, but
+///      each probe sees more candidates and false matches become extremely rare.
+///
+/// A new game invalidates the whole Table in constant time by advancing the
+/// Table's epoch. A Bucket whose epoch differs is stale, and is zeroed on its
+/// first use, exactly as if the whole Table had been cleared. This keeps the
+/// search deterministic. When the 16-bit epoch wraps around, or on request, the
+/// Table is physically cleared, which also resets the epoch back to zero.
 ///
 /// Generally, we prefer to replace entries that came from previous searches,
 /// as well as those which come from a lower depth. However, sometimes we do
@@ -49,6 +62,38 @@
 /// The minimum size of the Transposition Table is 2MB. This is so that we
 /// can lookup the table with at least 16-bits, and so that we may align the
 /// Table on a 2MB memory boundary, when available via the Operating System.
+/// On Linux, we first try to reserve explicit huge pages from the hugetlbfs
+/// pool, using 1GB pages for Tables of at least 1GB, and otherwise 2MB pages.
+/// Failing that, we fall back to requesting Transparent Huge Pages, which the
+/// kernel may or may not grant, and finally to normal pages.
+///
+/// The Table may be saved to a file and restored later. Files begin with a 64KB
+/// header, so that the Buckets themselves can be mapped directly from the file
+/// with mmap(), paging in lazily as they are probed. The header records the file
+/// version, the Bucket layout, the number of Buckets, the epoch and generation. Files
+/// from another version, or for a different Hash or HashLayout, are rejected.
+///
+/// With the HashShare option, the Table lives in a named POSIX shared memory
+/// segment, so that cooperating processes on one host probe and store into the
+/// same Buckets. The segment starts with the same header as a saved file, which
+/// the first process fills in. Others only attach when their Hash and HashLayout
+/// agree, and otherwise keep a private Table. The header also tracks the process
+/// ids attached, so that the last process to detach, either on a resize or when
+/// exiting, unlinks the segment. Processes which died are pruned on the way. A
+/// shared Table is not invalidated by ucinewgame, as that would disrupt others.
+///
+/// Each Thread may also own a small near Table, sized to stay resident in its L2
+/// cache. When the NearHashDepth option is set, stores below that depth, which
+/// includes all of those made by qsearch, go into the near Table instead, where
+/// they no longer evict deeper Entries or cost a trip to main memory. Probes
+/// only consult the near Table when the shared Table lacks a deep enough Entry.
+///
+/// Linux builds made with NUMA=interleave or NUMA=local place the pages of the
+/// Table deliberately, by first touching each 2MB block from a thread bound to
+/// the desired node. Interleaving spreads the blocks evenly over every node, so
+/// that no single memory controller serves every probe. Local placement splits
+/// the Table into one slice per node, and each group of search Threads is bound
+/// to a node and only probes the slice that resides in its own memory.
 
 enum {
     BOUND_NONE  = 0,
@@ -58,34 +103,136 @@ enum {
 
     TT_MASK_BOUND = 0x03,
     TT_MASK_AGE   = 0xFC,
-    TT_BUCKET_NB  = 3,
+
+    TT_BUCKET_NB      = 3,
+    TT_WIDE_BUCKET_NB = 5,
+
+    TT_NEAR_BUCKETS   = 8192, // 256KB of 32-byte Buckets
+    TT_NEAR_MAX_DEPTH = 8,
+
+    TT_PENDING_ENTRIES = 1 << 16, // 1MB of pending stores per Thread
+};
+
+enum { TT_LAYOUT_32B, TT_LAYOUT_64B };
+
+enum { TT_ALLOC_HEAP, TT_ALLOC_FILE, TT_ALLOC_HUGETLB, TT_ALLOC_SHARED };
+
+enum {
+    TT_FILE_OK, TT_FILE_IO_ERROR, TT_FILE_BAD_HEADER,
+    TT_FILE_MISMATCH, TT_FILE_TRUNCATED, TT_FILE_SHARED,
+
+    TT_FILE_VERSION = 2,
+    TT_FILE_HEADER  = 1 << 16,
+};
+
+enum {
+    TT_SHARE_OFF, TT_SHARE_CREATED, TT_SHARE_ATTACHED,
+    TT_SHARE_MISMATCH, TT_SHARE_ERROR,
+
+    TT_SHARE_MAX_PROCS = 256,
 };
 
 struct TTEntry {
     int8_t depth;
     uint8_t generation;
     int16_t eval, value;
-    uint16_t move, hash16;
+    uint16_t move;
 };
 
 struct TTBucket {
+    uint16_t keys[TT_BUCKET_NB];
+    uint16_t epoch;
     TTEntry slots[TT_BUCKET_NB];
-    uint16_t padding;
+};
+
+struct TTWideBucket {
+    uint32_t keys[TT_WIDE_BUCKET_NB];
+    uint32_t epoch;
+    TTEntry slots[TT_WIDE_BUCKET_NB];
+};
+
+/// Deterministic multithreaded searches leave the Table untouched during each
+/// iteration. Every Thread keeps its stores in its own pending Table, which it
+/// probes ahead of the shared Table. Between iterations, while the helpers are
+/// waiting, the pending stores of each Thread are moved into the Table in order
+
+struct TTPending {
+    uint64_t hash;
+    TTEntry entry;
 };
 
 struct TTable {
-    TTBucket *buckets;
-    uint64_t hashMask;
+    union { TTBucket *buckets; TTWideBucket *wideBuckets; };
+    uint64_t hashMask, sliceMask, bytes;
+    uint16_t epoch;
+    uint8_t generation;
+    int layout, placement, slices, allocation, nearDepth;
+};
+
+/// Builds made with STATS=1 count the traffic of each Thread into the Table. A
+/// false hit is a probe which matched the key, but returned a move that is not
+/// even pseudo legal, which reveals a collision of the verification keys. When
+/// a store does not match the key, it either fills an empty slot, evicts an
+/// Entry from an older search, or evicts an Entry from this search that was of
+/// the lowest depth. Stores which match the key either update the Entry, or
+/// skip it to preserve a deeper Entry. Hits and stores in the near Table are
+/// also counted separately, in addition to the totals. Probes and hits of the
+/// Pawn King evaluation cache are kept alongside, to be reported in the same way
+
+struct TTStats {
+    uint64_t probes, hits, falseHits;
+    uint64_t stores, updates, skips, fills, replacedAge, replacedDepth;
+    uint64_t nearHits, nearStores;
+    uint64_t pkProbes, pkHits;
+};
+
+#ifdef USE_STATS
+    #define TT_STAT(thread, field) ((thread)->ttstats.field++)
+#else
+    #define TT_STAT(thread, field) ((void) 0)
+#endif
+
+struct TTFileHeader {
+    char magic[8];
+    uint32_t version, layout;
+    uint64_t buckets, bucketSize;
+    uint16_t epoch;
     uint8_t generation;
 };
 
+struct TTShareHeader {
+    TTFileHeader table;
+    uint32_t ready;
+    int32_t pids[TT_SHARE_MAX_PROCS];
+};
+
 void tt_update();
 void tt_prefetch(uint64_t hash);
 
 int tt_init(int nthreads, int megabytes);
+void tt_numa_attach(int index, int nthreads);
+int tt_megabytes();
+uint64_t tt_page_size(int *percent);
 int tt_hashfull();
-bool tt_probe(uint64_t hash, int height, uint16_t *move, int *value, int *eval, int *depth, int *bound);
-void tt_store(uint64_t hash, int height, uint16_t move, int value, int eval, int depth, int bound);
+int tt_save(const char *fname);
+int tt_load(const char *fname);
+bool tt_probe(Thread *thread, uint64_t hash, uint16_t *move, int *value, int *eval, int *depth, int *bound);
+void tt_store(Thread *thread, uint64_t hash, uint16_t move, int value, int eval, int depth, int bound);
+void tt_print_stats(Thread *threads, const char *prefix);
+
+TTBucket* tt_near_create();
+void tt_near_clear(Thread *threads);
+void tt_pending_flush(Thread *threads);
+
+struct TTJob { bool clearOnly; int megabytes; void (*done)(); };
+void tt_resize_async(int megabytes, void (*done)());
+void tt_clear_async();
+void tt_wait();
+void tt_invalidate();
+int tt_share(int nthreads, const char *name);
+int tt_share_status();
+
+enum { TT_CLEAR_MAX_WORKERS = 1024 };
 
 struct TTClear { int index, count; };
 void tt_clear(int nthreads);
@@ -97,15 +244,12 @@ void *tt_clear_threaded(void *cargo);
 ///
 /// While this table is seldom accessed when using Ethereal NNUE, the table generally has
 /// an extremely high, 95%+ hit rate, generating a substantial overall speedup to Ethereal.
+///
+/// Each Thread allocates its own table, sized by the PKCache option, which may be zero
+/// for deployments which only use NNUE. Entries keep the upper half of the Pawn King
+/// hash as their key, since the lower bits already select the Entry, for 24 bytes each.
 
-enum {
-    PK_CACHE_KEY_SIZE = 16,
-    PK_CACHE_MASK     = 0xFFFF,
-    PK_CACHE_SIZE     = 1 << PK_CACHE_KEY_SIZE,
-};
-
-struct PKEntry { uint64_t pkhash, passed; int eval, safetyw, safetyb; };
-typedef PKEntry PKTable[PK_CACHE_SIZE];
+struct PKEntry { uint64_t passed; uint32_t pkhash; int eval, safetyw, safetyb; };
 
 PKEntry* getCachedPawnKingEval(Thread *thread, const Board *board);
 void storeCachedPawnKingEval(Thread *thread, const Board *board, uint64_t passed, int eval, int safety[2]);
@@ -86,10 +86,19 @@ typedef struct EvalInfo EvalInfo;
 typedef struct MovePicker MovePicker;
 typedef struct TimeManager TimeManager;
 typedef struct PVariation PVariation;
+typedef struct SearchStats SearchStats;
 typedef struct NodeState NodeState;
+typedef struct MateEntry MateEntry;
+typedef struct PerftEntry PerftEntry;
 typedef struct Thread Thread;
+typedef struct Worker Worker;
 typedef struct TTEntry TTEntry;
 typedef struct TTBucket TTBucket;
+typedef struct TTWideBucket TTWideBucket;
+typedef struct TTFileHeader TTFileHeader;
+typedef struct TTShareHeader TTShareHeader;
+typedef struct TTStats TTStats;
+typedef struct TTPending TTPending;
 typedef struct PKEntry PKEntry;
 typedef struct TTable TTable;
 typedef struct Limits Limits;
@@ -18,6 +18,7 @@
 
 #include <inttypes.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +34,8 @@
 #include "movegen.h"
 #include "network.h"
 #include "nnue/nnue.h"
+#include "numa.h"
+#include "perft.h"
 #include "pyrrhic/tbprobe.h"
 #include "search.h"
 #include "thread.h"
@@ -46,9 +49,19 @@ int NORMALIZE_EVAL = 1;
 
 extern int MoveOverhead;          // Defined by time.c
 extern unsigned TB_PROBE_DEPTH;   // Defined by syzygy.c
-extern volatile int ABORT_SIGNAL; // Defined by search.c
-extern volatile int IS_PONDERING; // Defined by search.c
+extern atomic_int IS_PONDERING;   // Defined by search.c
 extern PKNetwork PKNN;            // Defined by network.c
+extern TTable Table;              // Defined by transposition.c
+extern int AffinityPolicy;        // Defined by windows.c
+extern int EvalCacheMB;           // Defined by thread.c
+extern int PKCacheMB;             // Defined by thread.c
+extern int ThreadHugePages;       // Defined by thread.c
+extern int DeterministicSMP;      // Defined by thread.c
+extern int HelperSkipDepths;      // Defined by search.c
+extern int HelperWindowOffset;    // Defined by search.c
+extern int HelperMoveNoise;       // Defined by search.c
+extern int MultiPVSplit;          // Defined by search.c
+extern int MateHashMB;            // Defined by mate.c
 
 const char *StartPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
@@ -57,7 +70,7 @@ int main(int argc, char **argv) {
     Board board;
     char str[8192] = {0};
     Thread *threads;
-    pthread_t pthreadsgo;
+    Worker searcher;
     UCIGoStruct uciGoStruct;
 
     int chess960 = 0;
@@ -65,11 +78,12 @@ int main(int argc, char **argv) {
 
     // Initialize core components of Ethereal
     initAttacks(); initMasks(); initEval();
-    initSearch(); initZobrist(); tt_init(1, 16);
+    initSearch(); initZobrist(); numa_init(); tt_init(1, 16);
     initPKNetwork(); nnue_incbin_init();
 
     // Create the UCI-board and our threads
     threads = createThreadPool(1);
+    createWorker(&searcher);
     boardFromFEN(&board, StartPosition, chess960);
 
     // Handle any command line requests
@@ -89,7 +103,11 @@ int main(int argc, char **argv) {
     |       stop |            Signals the search threads to finish and report a bestmove |
     |       quit |             Exits the engine and any searches by killing the UCI loop |
     |      perft |            Custom command to compute PERFT(N) of the current position |
+    |     divide |          Custom command to compute PERFT(N) for each move at the root |
     |      print |         Custom command to print an ASCII view of the current position |
+    |  hashstats |  Custom command to report TT usage counters in builds made with STATS=1 |
+    |   savehash | *    Custom command to write the Transposition Table to the given file |
+    |   loadhash | *  Custom command to restore the Transposition Table from a given file |
     |------------|-----------------------------------------------------------------------|
     */
 
@@ -99,9 +117,23 @@ int main(int argc, char **argv) {
             printf("id name Ethereal " ETHEREAL_VERSION "\n");
             printf("id author Andrew Grant, Alayan & Laldon\n");
             printf("option name Hash type spin default 16 min 2 max 131072\n");
+            printf("option name HashLayout type combo default 32B var 32B var 64B\n");
+            printf("option name Clear Hash type button\n");
+            printf("option name HashShare type string default <empty>\n");
+            printf("option name NearHashDepth type spin default 0 min 0 max %d\n", TT_NEAR_MAX_DEPTH);
             printf("option name Threads type spin default 1 min 1 max 2048\n");
+            printf("option name Affinity type combo default compact var compact var spread var off\n");
+            printf("option name ThreadHugePages type check default false\n");
+            printf("option name DeterministicSMP type check default false\n");
+            printf("option name HelperSkipDepths type check default false\n");
+            printf("option name HelperWindowOffset type spin default 0 min 0 max 100\n");
+            printf("option name HelperMoveNoise type spin default 0 min 0 max 4096\n");
+            printf("option name EvalCache type spin default 0 min 0 max 1024\n");
+            printf("option name PKCache type spin default 2 min 0 max 1024\n");
             printf("option name EvalFile type string default <empty>\n");
             printf("option name MultiPV type spin default 1 min 1 max 256\n");
+            printf("option name MultiPVSplit type check default false\n");
+            printf("option name MateHash type spin default 16 min 1 max 65536\n");
             printf("option name MoveOverhead type spin default 300 min 0 max 10000\n");
             printf("option name SyzygyPath type string default <empty>\n");
             printf("option name SyzygyProbeDepth type spin default 0 min 0 max 127\n");
@@ -116,7 +148,7 @@ int main(int argc, char **argv) {
             printf("readyok\n"), fflush(stdout);
 
         else if (strEquals(str, "ucinewgame"))
-            resetThreadPool(threads), tt_clear(threads->nthreads);
+            resetThreadPool(threads), tt_invalidate();
 
         else if (strStartsWith(str, "setoption"))
             uciSetOption(str, &threads, &multiPV, &chess960);
@@ -125,32 +157,41 @@ int main(int argc, char **argv) {
             uciPosition(str, &board, chess960);
 
         else if (strStartsWith(str, "go"))
-            uciGo(&uciGoStruct, &pthreadsgo, threads, &board, multiPV, str);
+            uciGo(&uciGoStruct, &searcher, threads, &board, multiPV, str);
 
         else if (strEquals(str, "ponderhit"))
-            IS_PONDERING = 0;
+            signalPonderhit();
 
         else if (strEquals(str, "stop"))
-            ABORT_SIGNAL = 1, IS_PONDERING = 0;
+            signalStop();
 
         else if (strEquals(str, "quit"))
             break;
 
-        else if (strStartsWith(str, "perft"))
-            printf("%"PRIu64"\n", perft(&board, atoi(str + strlen("perft ")))), fflush(stdout);
+        else if (strStartsWith(str, "perft") || strStartsWith(str, "divide"))
+            uciPerft(str, &board);
 
         else if (strStartsWith(str, "print"))
             printBoard(&board), fflush(stdout);
+
+        else if (strEquals(str, "hashstats"))
+            tt_wait(), uciHashStats(threads);
+
+        else if (strStartsWith(str, "savehash "))
+            tt_wait(), uciHashFile(str + strlen("savehash "), tt_save(str + strlen("savehash ")), "saved");
+
+        else if (strStartsWith(str, "loadhash "))
+            tt_wait(), uciHashFile(str + strlen("loadhash "), tt_load(str + strlen("loadhash ")), "loaded");
     }
 
     return 0;
 }
 
-void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board, int multiPV, char *str) {
+void uciGo(UCIGoStruct *ucigo, Worker *worker, Thread *threads, Board *board, int multiPV, char *str) {
 
     /// Parse the entire "go" command in order to fill out a Limits struct, found at ucigo->limits.
-    /// After we have processed all of this, we can execute a new search thread, held by *pthread,
-    /// and detach it.
+    /// After we have processed all of this, we can wake the parked search Worker, held by *worker,
+    /// to run the search in the background.
 
     double start = get_real_time();
     double wtime = 0, btime = 0;
@@ -163,6 +204,9 @@ void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board
     int size = genAllLegalMoves(board, moves), idx = 0;
 
     Limits *limits = &ucigo->limits;
+
+    // Finish the last search, and any pending resize or clear of the TT
+    waitWorker(worker), tt_wait();
     memset(limits, 0, sizeof(Limits));
 
     IS_PONDERING = FALSE; // Reset PONDERING every time to be safe
@@ -180,6 +224,7 @@ void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board
         if (strEquals(ptr, "depth"      )) limits->depthLimit = atoi(strtok(NULL, " "));
         if (strEquals(ptr, "movetime"   )) limits->timeLimit  = atoi(strtok(NULL, " "));
         if (strEquals(ptr, "nodes"      )) limits->nodeLimit  = atof(strtok(NULL, " "));
+        if (strEquals(ptr, "mate"       )) limits->mateLimit  = atoi(strtok(NULL, " "));
 
         // Parse special search modes
         if (strEquals(ptr, "infinite"   )) limits->limitedByNone  = TRUE;
@@ -193,14 +238,16 @@ void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board
         }
     }
 
-    // Special exit cases: Time, Depth, and Nodes
+    // Special exit cases: Time, Depth, Nodes, and Mates
     limits->limitedByTime  = limits->timeLimit  != 0;
     limits->limitedByDepth = limits->depthLimit != 0;
     limits->limitedByNodes = limits->nodeLimit  != 0;
+    limits->limitedByMate  = limits->mateLimit   > 0;
 
     // No special case nor infinite, so we set our own time
     limits->limitedBySelf  = !limits->depthLimit    && !limits->timeLimit
-                          && !limits->limitedByNone && !limits->nodeLimit;
+                          && !limits->limitedByNone && !limits->nodeLimit
+                          && !limits->limitedByMate;
 
     // Pick the time values for the colour we are playing as
     limits->start = (board->turn == WHITE) ? start : start;
@@ -215,18 +262,31 @@ void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board
     ucigo->board   = board;
     ucigo->threads = threads;
 
-    // Spawn a new thread to handle the search
-    pthread_create(pthread, NULL, &start_search_threads, ucigo);
-    pthread_detach(*pthread);
+    // Wake the Worker to handle the search
+    startWorker(worker, &start_search_threads, ucigo);
 }
 
 void uciSetOption(char *str, Thread **threads, int *multiPV, int *chess960) {
 
     // Handle setting UCI options in Ethereal. Options include:
     //  Hash                : Size of the Transposition Table in Megabyes
+    //  HashLayout          : Size of each Transposition Table Bucket, 32 or 64 bytes
+    //  Clear Hash          : Physically zero the Transposition Table, unlike ucinewgame
+    //  HashShare           : Name of a shared memory segment to hold the Transposition Table
+    //  NearHashDepth       : Keep Entries below this depth in small per-thread Tables, if not 0
     //  Threads             : Number of search threads to use
+    //  Affinity            : Policy for binding search threads to CPUs, when using 9+
+    //  ThreadHugePages     : Request Transparent Huge Pages for each search thread's state
+    //  DeterministicSMP    : Reproducible multithreaded searches, synchronised every depth
+    //  HelperSkipDepths    : Helper threads skip some depths of iterative deepening
+    //  HelperWindowOffset  : Helper threads shift their aspiration windows up or down
+    //  HelperMoveNoise     : Helper threads perturb the quiet move ordering near the root
+    //  EvalCache           : Size of each search thread's static evaluation cache in Megabytes
+    //  PKCache             : Size of each search thread's Pawn King cache in Megabytes, or 0
     //  EvalFile            : Network weights for Ethereal's NNUE evaluation
     //  MultiPV             : Number of search lines to report per iteration
+    //  MultiPVSplit        : Share out the root moves between threads in MultiPV searches
+    //  MateHash            : Size of the proof-number search table for "go mate" in Megabytes
     //  MoveOverhead        : Overhead on time allocation to avoid time losses
     //  SyzygyPath          : Path to Syzygy Tablebases
     //  SyzygyProbeDepth    : Minimal Depth to probe the highest cardinality Tablebase
@@ -234,8 +294,35 @@ void uciSetOption(char *str, Thread **threads, int *multiPV, int *chess960) {
     //  UCI_Chess960        : Set when playing FRC, but not required in order to work
 
     if (strStartsWith(str, "setoption name Hash value ")) {
-        int megabytes = atoi(str + strlen("setoption name Hash value "));
-        printf("info string set Hash to %dMB\n", tt_init((*threads)->nthreads, megabytes));
+        int megabytes = MAX(1, atoi(str + strlen("setoption name Hash value ")));
+        tt_resize_async(megabytes, uciReportHashPages);
+    }
+
+    if (strStartsWith(str, "setoption name HashLayout value ")) {
+        int megabytes = (tt_wait(), tt_megabytes());
+        if (strStartsWith(str, "setoption name HashLayout value 32B"))
+            Table.layout = TT_LAYOUT_32B, tt_resize_async(megabytes, NULL);
+        if (strStartsWith(str, "setoption name HashLayout value 64B"))
+            Table.layout = TT_LAYOUT_64B, tt_resize_async(megabytes, NULL);
+        printf("info string set HashLayout to %s\n", Table.layout == TT_LAYOUT_64B ? "64B" : "32B");
+    }
+
+    if (strStartsWith(str, "setoption name Clear Hash"))
+        tt_clear_async(), tt_near_clear(*threads), printf("info string cleared Hash\n");
+
+    if (strStartsWith(str, "setoption name HashShare value ")) {
+        char *ptr = str + strlen("setoption name HashShare value ");
+        int status = tt_share((*threads)->nthreads, strStartsWith(ptr, "<empty>") ? "" : ptr);
+        printf("info string set HashShare to %s\n", ptr);
+        uciReportHashShare(status);
+    }
+
+    if (strStartsWith(str, "setoption name NearHashDepth value ")) {
+        int depth = atoi(str + strlen("setoption name NearHashDepth value "));
+        Table.nearDepth = MAX(0, MIN(TT_NEAR_MAX_DEPTH, depth));
+        int nthreads = (*threads)->nthreads;
+        deleteThreadPool(*threads); *threads = createThreadPool(nthreads);
+        printf("info string set NearHashDepth to %d\n", Table.nearDepth);
     }
 
     if (strStartsWith(str, "setoption name Threads value ")) {
@@ -244,6 +331,60 @@ void uciSetOption(char *str, Thread **threads, int *multiPV, int *chess960) {
         printf("info string set Threads to %d\n", nthreads);
     }
 
+    if (strStartsWith(str, "setoption name ThreadHugePages value ")) {
+        ThreadHugePages = strStartsWith(str, "setoption name ThreadHugePages value true");
+        int nthreads = (*threads)->nthreads;
+        deleteThreadPool(*threads); *threads = createThreadPool(nthreads);
+        printf("info string set ThreadHugePages to %s\n", ThreadHugePages ? "true" : "false");
+    }
+
+    if (strStartsWith(str, "setoption name DeterministicSMP value ")) {
+        DeterministicSMP = strStartsWith(str, "setoption name DeterministicSMP value true");
+        int nthreads = (*threads)->nthreads;
+        deleteThreadPool(*threads); *threads = createThreadPool(nthreads);
+        printf("info string set DeterministicSMP to %s\n", DeterministicSMP ? "true" : "false");
+    }
+
+    if (strStartsWith(str, "setoption name HelperSkipDepths value ")) {
+        if (strStartsWith(str, "setoption name HelperSkipDepths value true"))
+            printf("info string set HelperSkipDepths to true\n"), HelperSkipDepths = 1;
+        if (strStartsWith(str, "setoption name HelperSkipDepths value false"))
+            printf("info string set HelperSkipDepths to false\n"), HelperSkipDepths = 0;
+    }
+
+    if (strStartsWith(str, "setoption name HelperWindowOffset value ")) {
+        HelperWindowOffset = MAX(0, MIN(100, atoi(str + strlen("setoption name HelperWindowOffset value "))));
+        printf("info string set HelperWindowOffset to %d\n", HelperWindowOffset);
+    }
+
+    if (strStartsWith(str, "setoption name HelperMoveNoise value ")) {
+        HelperMoveNoise = MAX(0, MIN(4096, atoi(str + strlen("setoption name HelperMoveNoise value "))));
+        printf("info string set HelperMoveNoise to %d\n", HelperMoveNoise);
+    }
+
+    if (strStartsWith(str, "setoption name EvalCache value ")) {
+        EvalCacheMB = MAX(0, atoi(str + strlen("setoption name EvalCache value ")));
+        int nthreads = (*threads)->nthreads;
+        deleteThreadPool(*threads); *threads = createThreadPool(nthreads);
+        printf("info string set EvalCache to %dMB\n", EvalCacheMB);
+    }
+
+    if (strStartsWith(str, "setoption name PKCache value ")) {
+        PKCacheMB = MAX(0, atoi(str + strlen("setoption name PKCache value ")));
+        int nthreads = (*threads)->nthreads;
+        deleteThreadPool(*threads); *threads = createThreadPool(nthreads);
+        printf("info string set PKCache to %dMB\n", PKCacheMB);
+    }
+
+    if (strStartsWith(str, "setoption name Affinity value ")) {
+        if (strStartsWith(str, "setoption name Affinity value compact"))
+            printf("info string set Affinity to compact\n"), AffinityPolicy = AFFINITY_COMPACT;
+        if (strStartsWith(str, "setoption name Affinity value spread"))
+            printf("info string set Affinity to spread\n"), AffinityPolicy = AFFINITY_SPREAD;
+        if (strStartsWith(str, "setoption name Affinity value off"))
+            printf("info string set Affinity to off\n"), AffinityPolicy = AFFINITY_OFF;
+    }
+
     if (strStartsWith(str, "setoption name EvalFile value ")) {
         char *ptr = str + strlen("setoption name EvalFile value ");
         if (!strStartsWith(ptr, "<empty>")) nnue_init(ptr);
@@ -255,6 +396,18 @@ void uciSetOption(char *str, Thread **threads, int *multiPV, int *chess960) {
         printf("info string set MultiPV to %d\n", *multiPV);
     }
 
+    if (strStartsWith(str, "setoption name MultiPVSplit value ")) {
+        if (strStartsWith(str, "setoption name MultiPVSplit value true"))
+            printf("info string set MultiPVSplit to true\n"), MultiPVSplit = 1;
+        if (strStartsWith(str, "setoption name MultiPVSplit value false"))
+            printf("info string set MultiPVSplit to false\n"), MultiPVSplit = 0;
+    }
+
+    if (strStartsWith(str, "setoption name MateHash value ")) {
+        MateHashMB = MAX(1, atoi(str + strlen("setoption name MateHash value ")));
+        printf("info string set MateHash to %d\n", MateHashMB);
+    }
+
     if (strStartsWith(str, "setoption name MoveOverhead value ")) {
         MoveOverhead = atoi(str + strlen("setoption name MoveOverhead value "));
         printf("info string set MoveOverhead to %d\n", MoveOverhead);
@@ -339,6 +492,115 @@ void uciPosition(char *str, Board *board, int chess960) {
     }
 }
 
+void uciPerft(char *str, Board *board) {
+
+    /// "perft <depth> [threads] [hash]" prints only the count, as expected by
+    /// perft.py, while "divide <depth> [threads] [hash]" breaks down the count
+    /// over the moves at the root, followed by the total and the speed
+
+    char movestr[6];
+    uint16_t moves[MAX_MOVES];
+    uint64_t counts[MAX_MOVES];
+    int depth = 0, nthreads = 1, megabytes = 0, size;
+
+    sscanf(str, "%*s %d %d %d", &depth, &nthreads, &megabytes);
+
+    double start = get_real_time();
+    uint64_t total = perftRoot(board, depth, nthreads, megabytes, moves, counts, &size);
+    double elapsed = get_real_time() - start;
+
+    if (!strStartsWith(str, "divide")) {
+        printf("%"PRIu64"\n", total), fflush(stdout);
+        return;
+    }
+
+    for (int i = 0; i < size && depth > 0; i++) {
+        moveToString(moves[i], movestr, board->chess960);
+        printf("%s: %"PRIu64"\n", movestr, counts[i]);
+    }
+
+    printf("\nNodes: %"PRIu64"\nTime: %dms\nMNPS: %.2f\n", total,
+        (int) elapsed, total / (1000.0 * MAX(1.0, elapsed)));
+    fflush(stdout);
+}
+
+void uciHashStats(Thread *threads) {
+
+#ifdef USE_STATS
+    tt_print_stats(threads, "info string ");
+#else
+    (void) threads;
+    printf("info string hashstats requires a build made with STATS=1\n");
+#endif
+
+    fflush(stdout);
+}
+
+static const char *uciHashShareOutcome(int status) {
+
+    static const char *Outcomes[] = {
+        [TT_SHARE_OFF     ] = "Hash is private to this process",
+        [TT_SHARE_CREATED ] = "created a new shared Hash",
+        [TT_SHARE_ATTACHED] = "attached to an existing shared Hash",
+        [TT_SHARE_MISMATCH] = "shared Hash does not match the current Hash and HashLayout, using a private Hash",
+        [TT_SHARE_ERROR   ] = "unable to share the Hash, using a private Hash",
+    };
+
+    return Outcomes[status];
+}
+
+void uciReportHashShare(int status) {
+    printf("info string %s\n", uciHashShareOutcome(status));
+}
+
+void uciReportHashPages() {
+
+    /// Called once the Table has been resized, possibly by a background thread. The
+    /// report is built up in a buffer and written with a single call, so that it is
+    /// never spliced into the middle of the main thread's output, such as readyok
+
+    char buffer[512];
+    int percent, length = 0;
+    uint64_t size = tt_page_size(&percent);
+
+    length += snprintf(buffer + length, sizeof(buffer) - length, "info string set Hash to %dMB\n", tt_megabytes());
+
+    const char *kind = Table.allocation == TT_ALLOC_HUGETLB ? "explicit huge"
+                     : size > 4096 && Table.allocation == TT_ALLOC_HEAP ? "transparent huge" : "normal";
+
+    // Report pages as 4KB, 2MB, or 1GB, as well as their coverage of the Table
+    const int shift = size >= (1ull << 30) ? 30 : size >= (1ull << 20) ? 20 : 10;
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+        "info string Hash uses %s pages of %d%s for %d%% of the table\n",
+        kind, (int) (size >> shift), shift == 30 ? "GB" : shift == 20 ? "MB" : "KB", percent);
+
+    // Resizing a shared Table must find or create a segment of the new size
+    if (tt_share_status() != TT_SHARE_OFF)
+        snprintf(buffer + length, sizeof(buffer) - length,
+            "info string %s\n", uciHashShareOutcome(tt_share_status()));
+
+    fputs(buffer, stdout);
+    fflush(stdout);
+}
+
+void uciHashFile(char *fname, int status, char *action) {
+
+    static const char *Reasons[] = {
+        [TT_FILE_IO_ERROR  ] = "unable to access the file",
+        [TT_FILE_BAD_HEADER] = "not a hash file from this version of Ethereal",
+        [TT_FILE_MISMATCH  ] = "the file does not match the current Hash and HashLayout",
+        [TT_FILE_TRUNCATED ] = "the file is incomplete",
+        [TT_FILE_SHARED    ] = "the Hash is shared with other processes, clear HashShare first",
+    };
+
+    if (status == TT_FILE_OK)
+        printf("info string %s hash file %s\n", action, fname);
+    else
+        printf("info string hash file %s not %s: %s\n", fname, action, Reasons[status]);
+
+    fflush(stdout);
+}
+
 
 void uciReport(Thread *threads, PVariation *pv, int alpha, int beta) {
 
@@ -43,6 +43,7 @@ struct Limits {
     double start, time, inc, mtg, timeLimit;
     int limitedByNone, limitedByTime, limitedBySelf;
     int limitedByDepth, limitedByMoves, limitedByNodes;
+    int limitedByMate, mateLimit;
     int multiPV, depthLimit; uint64_t nodeLimit;
     uint16_t searchMoves[MAX_MOVES], excludedMoves[MAX_MOVES];
 };
@@ -53,9 +54,14 @@ struct UCIGoStruct {
     Limits  limits;
 };
 
-void uciGo(UCIGoStruct *ucigo, pthread_t *pthread, Thread *threads, Board *board, int multiPV, char *str);
+void uciGo(UCIGoStruct *ucigo, Worker *worker, Thread *threads, Board *board, int multiPV, char *str);
 void uciSetOption(char *str, Thread **threads, int *multiPV, int *chess960);
 void uciPosition(char *str, Board *board, int chess960);
+void uciPerft(char *str, Board *board);
+void uciHashStats(Thread *threads);
+void uciReportHashShare(int status);
+void uciReportHashPages();
+void uciHashFile(char *fname, int status, char *action);
 
 void uciReport(Thread *threads, PVariation *pv, int alpha, int beta);
 void uciReportCurrentMove(Board *board, uint16_t move, int currmove, int depth);
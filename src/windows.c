@@ -21,9 +21,107 @@
 #pragma GCC diagnostic ignored "-Wcast-function-type"
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+    #define _GNU_SOURCE
+    #include <pthread.h>
+    #include <sched.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+#endif
+
+#include "numa.h"
 #include "windows.h"
 
-#ifndef _WIN32
+int AffinityPolicy = AFFINITY_COMPACT; // Set by the UCI option Affinity
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+typedef struct OrderedCPU { int key, cpu; } OrderedCPU;
+
+static int CPUCount, CPUOrder[2][CPU_SETSIZE];
+static cpu_set_t ProcessCPUs;
+static pthread_once_t TopologyOnce = PTHREAD_ONCE_INIT;
+
+static int readTopology(int cpu, const char *name) {
+
+    // Read a single value from /sys/devices/system/cpu/cpu<N>/topology
+
+    char fname[256]; int value = -1;
+    sprintf(fname, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    FILE *fin = fopen(fname, "r");
+    if (fin != NULL && fscanf(fin, "%d", &value) != 1) value = -1;
+    if (fin != NULL) fclose(fin);
+
+    return value;
+}
+
+static int compareOrderedCPUs(const void *a, const void *b) {
+    return ((const OrderedCPU*) a)->key - ((const OrderedCPU*) b)->key;
+}
+
+static void initTopology() {
+
+    // initTopology() orders the CPUs available to the process for both of the
+    // binding policies. Each places one logical processor of every core before
+    // using any SMT siblings. Compact fills up a NUMA node before moving to the
+    // next node, while spread rotates through the nodes with each new thread.
+
+    int package[CPU_SETSIZE], core[CPU_SETSIZE], node[CPU_SETSIZE];
+    int sibling[CPU_SETSIZE], rank[CPU_SETSIZE], cpus[CPU_SETSIZE];
+    OrderedCPU compact[CPU_SETSIZE], spread[CPU_SETSIZE];
+
+    sched_getaffinity(0, sizeof(cpu_set_t), &ProcessCPUs);
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+
+        if (!CPU_ISSET(cpu, &ProcessCPUs)) continue;
+
+        package[cpu] = readTopology(cpu, "physical_package_id");
+        core[cpu]    = readTopology(cpu, "core_id");
+        node[cpu]    = numa_cpu_node(cpu);
+
+        // Count the earlier logical processors on the same physical core
+        sibling[cpu] = 0;
+        for (int i = 0; i < CPUCount && core[cpu] != -1; i++)
+            sibling[cpu] += package[cpus[i]] == package[cpu] && core[cpus[i]] == core[cpu];
+
+        // Position among the processors of this node with the same sibling index
+        rank[cpu] = 0;
+        for (int i = 0; i < CPUCount; i++)
+            rank[cpu] += node[cpus[i]] == node[cpu] && sibling[cpus[i]] == sibling[cpu];
+
+        compact[CPUCount] = (OrderedCPU) { (sibling[cpu] * NUMA_MAX_NODES + node[cpu]) * CPU_SETSIZE + rank[cpu], cpu };
+        spread[CPUCount]  = (OrderedCPU) { (sibling[cpu] * CPU_SETSIZE + rank[cpu]) * NUMA_MAX_NODES + node[cpu], cpu };
+        cpus[CPUCount++]  = cpu;
+    }
+
+    qsort(compact, CPUCount, sizeof(OrderedCPU), compareOrderedCPUs);
+    qsort(spread,  CPUCount, sizeof(OrderedCPU), compareOrderedCPUs);
+
+    for (int i = 0; i < CPUCount; i++)
+        CPUOrder[0][i] = compact[i].cpu, CPUOrder[1][i] = spread[i].cpu;
+}
+
+void bindThisThread(int index) {
+
+    // bindThisThread() pins the current thread to a single logical processor,
+    // chosen by the policy. Threads which were not given a processor, as well
+    // as all threads when the policy is off, may run on any of the processors
+    // that the process started with. This undoes any inherited binding.
+
+    pthread_once(&TopologyOnce, initTopology);
+    cpu_set_t mask = ProcessCPUs;
+
+    if (AffinityPolicy != AFFINITY_OFF && index < CPUCount) {
+        CPU_ZERO(&mask);
+        CPU_SET(CPUOrder[AffinityPolicy == AFFINITY_SPREAD][index], &mask);
+    }
+
+    sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+}
+
+#elif !defined(_WIN32)
 
 void bindThisThread(int index) { (void)index; };
 
@@ -73,11 +171,12 @@ static int bestGroup(int index) {
 
     free(buffer); // Cleanup
 
-    // Run as many threads as possible on the same node until
-    // core limit is reached, then move on filling the next node.
+    // Run as many threads as possible on the same node until core limit
+    // is reached, then move on filling the next node. When spreading, the
+    // threads instead rotate through the nodes, one core at a time.
     for (int n = 0; n < nodes; n++)
-        for (int i = 0; i < cores / nodes; i++)
-            groups[groupSize++] = n;
+        for (int i = 0; i < cores / nodes; i++, groupSize++)
+            groups[groupSize] = AffinityPolicy == AFFINITY_SPREAD ? groupSize % nodes : n;
 
     // In case a core has more than one logical processor (we assume 2) and we
     // still have threads to allocate, then spread them across available nodes.
@@ -94,7 +193,7 @@ void bindThisThread(int index) {
     // bindThisThread() sets the group affinity of the current thread
 
     GROUP_AFFINITY affinity;
-    int group = bestGroup(index);
+    int group = AffinityPolicy == AFFINITY_OFF ? -1 : bestGroup(index);
 
     // Check for a need to bind the thread
     if (group == -1) return;